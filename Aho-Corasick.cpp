@@ -1,86 +1,265 @@
 #include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <queue>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
-const int alphabet_size = 26;
-const char start_symbol = 'a';
+
+/* Арена: память выделяется большими блоками, из которых объекты нарезаются подряд.
+   Отдельные объекты не освобождаются, все блоки освобождаются разом при уничтожении арены,
+   поэтому в ней можно размещать только объекты с тривиальным деструктором. */
+class Arena {
+	static constexpr size_t block_size = 1 << 20;
+	vector <unique_ptr <char[]> > blocks;
+	// начало и размер свободной части последнего блока
+	char* free_space;
+	size_t free_size;
+	// сколько байт всего выделено блоками
+	size_t allocated;
+	
+public:
+	Arena(): free_space(nullptr), free_size(0), allocated(0) {}
+	
+	// Выделение неинициализированного массива из count объектов типа T.
+	template <class T>
+	T* allocate(size_t count) {
+		static_assert(is_trivially_destructible <T>::value, "arena never calls destructors");
+		size_t bytes = count * sizeof(T);
+		size_t shift = (alignof(T) - reinterpret_cast <uintptr_t>(free_space) % alignof(T)) % alignof(T);
+		if (shift + bytes > free_size) {
+			size_t size = max(block_size, bytes);
+			blocks.push_back(unique_ptr <char[]>(new char[size]));
+			free_space = blocks.back().get();
+			free_size = size;
+			allocated += size;
+			shift = 0;
+		}
+		T* result = reinterpret_cast <T*>(free_space + shift);
+		free_space += shift + bytes;
+		free_size -= shift + bytes;
+		return result;
+	}
+	
+	size_t memory_usage() const {
+		return allocated;
+	}
+	
+	// Освобождение всех блоков разом; после этого все выделенные из арены объекты недействительны.
+	void clear() {
+		vector <unique_ptr <char[]> >().swap(blocks);
+		free_space = nullptr;
+		free_size = 0;
+		allocated = 0;
+	}
+	
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+};
 
 
-// Бор. Реализованы операции добавления строки, вычисления суффиксных ссылок (в т.ч. сжатых),
-// переходы в новые состояния.
+/* Бор. Реализованы операции добавления строки, вычисления суффиксных ссылок (в т.ч. сжатых),
+   переходы в новые состояния. Символы - это start_symbol, start_symbol + 1, ..., 
+   start_symbol + alphabet_size - 1; по умолчанию - произвольные байты.
+   Внутри бора символы перенумерованы: код получают только те символы, которые встречаются в строках,
+   а все остальные (в том числе байты вне алфавита) имеют код 0 и из любого состояния ведут в корень. 
+   Строка, в которой есть байт вне алфавита, в бор не добавляется: найтись в тексте она не может. 
+   Вершины и их массивы рёбер живут в арене бора. Они нужны только при построении: 
+   freeze переносит автомат в сжатые массивы и освобождает арену, так что build вызывается один раз. */
+template <int alphabet_size = 256, char start_symbol = 0>
 class Trie {
+	static_assert(alphabet_size > 0 && alphabet_size <= 256, "symbols must fit in one byte");
+	
+	/* Если у вершины детей больше, чем столько, 
+	   то кроме отсортированного массива рёбер для неё заводится плотная таблица. */
+	static const int dense_threshold = 16;
+	/* Состояния не глубже этого тоже получают в сжатом автомате полную строку переходов: 
+	   почти весь поиск по обычному тексту идёт около корня. */
+	static const int dense_depth = 1;
+	
+	struct Node;
+	
+	// ребро бора: код символа и вершина, в которую оно ведёт
+	struct Edge {
+		int32_t code;
+		Node* child;
+	};
+	
 	// вершина бора
 	struct Node {
-		// хранит индексы строк, заканчивающихся в этой вершине 
-		// (индексы из вектора patterns, см. далее для понимания)
-		vector <int> ending_strings;
-		// рёбра дерева
-		vector <unique_ptr <Node> > transitions;
-		// переходы в новые состояния
-		vector <Node*> links;
+		/* Индексы строк, заканчивающихся в этой вершине (индексы из вектора patterns, см. далее для понимания), 
+		   хранятся списком в векторах endings и next_ending бора: это первый и последний его элементы (или -1). */
+		int32_t first_ending, last_ending;
+		// рёбра дерева, отсортированные по коду символа; edges_capacity - размер выделенного под них массива
+		Edge* edges;
+		int32_t edges_count, edges_capacity;
+		// плотная таблица рёбер по коду символа; заводится только для вершин с большим числом детей
+		Node** dense_transitions;
 		// суффиксная ссылка, сжатая суффиксная ссылка, родитель
 		Node *suffix_link, *compressed_link, *parent;
-		// по какому символу идёт ребро из родителя к вершине
-		char char_to_parent;
+		// код символа, по которому идёт ребро из родителя к вершине
+		int code_to_parent;
+		// номер состояния в сжатом представлении автомата (порядок обхода в ширину, см. make_links)
+		int32_t number;
+		
+		// На вход передаются родитель и код символа, по которому пришли в новую вершину.
+		Node(Node* parent_, int code_to_parent_): first_ending(-1), last_ending(-1), edges(nullptr), 
+		                                          edges_count(0), edges_capacity(0), dense_transitions(nullptr), 
+		                                          suffix_link(nullptr), compressed_link(nullptr), 
+		                                          parent(parent_), code_to_parent(code_to_parent_), number(0) {}
 		
-		Node(): char_to_parent('0') {
-			for (int i = 0; i < alphabet_size; i++) {
-				links.push_back(nullptr);
-				transitions.push_back(nullptr);
+		// Ребёнок по символу с кодом code или nullptr, если его нет.
+		Node* child(int code) const {
+			if (dense_transitions != nullptr) {
+				return dense_transitions[code];
 			}
+			Edge* it = lower_bound(edges, edges + edges_count, code, 
+			                       [](const Edge& edge, int c) { return edge.code < c; });
+			return (it != edges + edges_count && it->code == code ? it->child : nullptr);
 		}
 		
-		// На вход передаются родитель и символ, по которому пришли в новую вершину.
-		Node(Node* parent_, char char_to_parent_): parent(parent_), char_to_parent(char_to_parent_) {
-			for (int i = 0; i < alphabet_size; i++) {
-				links.push_back(nullptr);
-				transitions.push_back(nullptr);
+		/* Добавление ребёнка по символу с кодом code (которого ещё нет). 
+		   Когда массив рёбер заполнен, из арены берётся вдвое больший, а старый просто забывается. */
+		Node* add_child(int code, Arena& arena) {
+			if (edges_count == edges_capacity) {
+				edges_capacity = max(2 * edges_capacity, 2);
+				Edge* grown = arena.allocate <Edge>(edges_capacity);
+				copy(edges, edges + edges_count, grown);
+				edges = grown;
+			}
+			Edge* it = lower_bound(edges, edges + edges_count, code, 
+			                       [](const Edge& edge, int c) { return edge.code < c; });
+			copy_backward(it, edges + edges_count, edges + edges_count + 1);
+			Node* result = new (arena.allocate <Node>(1)) Node(this, code);
+			*it = {code, result};
+			edges_count++;
+			if (dense_transitions != nullptr) {
+				dense_transitions[code] = result;
+			}
+			else if (edges_count > dense_threshold) {
+				dense_transitions = arena.allocate <Node*>(alphabet_size + 1);
+				fill(dense_transitions, dense_transitions + alphabet_size + 1, nullptr);
+				for (int i = 0; i < edges_count; i++) {
+					dense_transitions[edges[i].code] = edges[i].child;
+				}
 			}
+			return result;
 		}
 	};
 	
+	// арена, из которой выделяются вершины и массивы рёбер
+	Arena arena;
+	// список строк, заканчивающихся в вершинах (см. Node::first_ending)
+	vector <int32_t> endings, next_ending;
 	// корень
-	unique_ptr <Node> root;
-	// текущее состояние
-	Node* current;
+	Node* root;
+	// количество вершин
+	int nodes;
 	
-	// Вычисление суффиксной ссылки для вершины node.
+	/* Перенумерация алфавита: symbol_code[c] - код символа start_symbol + c.
+	   Коды 1, ..., codes - 1 раздаются символам в порядке их появления в строках, код 0 - всем остальным. */
+	array <int32_t, alphabet_size> symbol_code;
+	int codes;
+	
+	/* Сжатое представление автомата, строится в freeze.
+	   Состояния занумерованы в порядке обхода в ширину, корень - состояние 0.
+	   Полная строка переходов есть только у состояний не глубже dense_depth и у состояний, где детей больше 
+	   dense_threshold: если dense_row[state] >= 0, то table[dense_row[state] * codes + code] - переход 
+	   из state по символу с кодом code. У остальных состояний хранятся только рёбра бора - коды 
+	   edge_codes[edge_begin[state]] ... edge_codes[edge_begin[state + 1] - 1] по возрастанию и состояния 
+	   edge_targets, в которые они ведут, а если нужного ребра нет, переход ищется из failure[state] 
+	   (суффиксной ссылки). У корня строка всегда полная, так что спуск по ссылкам на нём заканчивается. 
+	   Полных строк не больше, чем codes состояний глубины 1 плюс states / (dense_threshold + 1), 
+	   поэтому на состояние приходится O(1) чисел, а не codes.
+	   Номера строк, заканчивающихся в состоянии state, лежат в 
+	   outputs[output_begin[state]] ... outputs[output_begin[state + 1] - 1].
+	   output_links[state] - сжатая суффиксная ссылка (-1, если её нет). */
+	vector <int32_t> dense_row, table;
+	vector <int32_t> edge_begin, edge_codes, edge_targets, failure;
+	vector <int32_t> output_begin;
+	vector <int32_t> outputs;
+	vector <int32_t> output_links;
+	// state_nodes[state] - вершина бора, соответствующая состоянию state (заполняется в make_links).
+	vector <Node*> state_nodes;
+	
+	/* Массивы, по которым идёт поиск. После freeze указывают в векторы выше, 
+	   после load - в отображённый в память файл. */
+	struct View {
+		const int32_t *symbol_code, *dense_row, *table, *edge_begin, *edge_codes, *edge_targets, *failure, 
+		              *output_begin, *outputs, *output_links;
+		int32_t states, outputs_size, rows;
+	} view;
+	// отображённый в память файл и его размер (если автомат загружен через load)
+	void* mapped;
+	size_t mapped_size;
+	
+	/* Формат файла (все числа - int32_t): 
+	   заголовок {file_magic, alphabet_size, start_symbol, codes, states, outputs_size, rows}, где rows - 
+	   число полных строк, затем symbol_code, dense_row, table, edge_begin, edge_codes, edge_targets, failure, 
+	   output_begin, outputs, output_links подряд. Рёбер бора всегда states - 1. */
+	static const int32_t file_magic = 0x32434148;
+	static const int header_size = 7;
+	
+	// Номер символа c в исходном алфавите (alphabet_size и больше - если c в алфавит не входит).
+	static int symbol_index(char c) {
+		return static_cast <unsigned char>(c - start_symbol);
+	}
+	
+	// Код символа c по таблице codes_of (для байтов вне алфавита - 0).
+	static int32_t symbol_code_of(const int32_t* codes_of, char c) {
+		int index = symbol_index(c);
+		return index < alphabet_size ? codes_of[index] : 0;
+	}
+	
+	/* Вычисление суффиксной ссылки для вершины node: спуск по ссылкам от родителя, 
+	   пока не найдётся вершина с ребром по тому же символу (ссылки всех менее глубоких вершин уже есть). */
 	void make_suffix_link(Node* node) {
-		if (node == root.get() || node->parent == root.get()) {
-			node->suffix_link = root.get();
+		if (node == root || node->parent == root) {
+			node->suffix_link = root;
+			return;
 		}
-		else {
-			node->suffix_link = node->parent->suffix_link->links[node->char_to_parent - start_symbol];
+		Node* link = node->parent->suffix_link;
+		Node* next = link->child(node->code_to_parent);
+		while (next == nullptr && link != root) {
+			link = link->suffix_link;
+			next = link->child(node->code_to_parent);
 		}
+		node->suffix_link = (next != nullptr ? next : root);
 	}
 	
-	// Вычисление переходов для вершины node.
-	void make_links(Node* node) {
-		for (int c = 0; c < alphabet_size; c++) {
-			if (node->transitions[c] == nullptr) {
-				if (node == root.get()) {
-					node->links[c] = root.get();
-				}
-				else {
-					node->links[c] = node->suffix_link->links[c];
+	/* Переход из состояния state по символу с кодом code в сжатом автомате: 
+	   по рёбрам бора, пока нет полной строки, и по суффиксным ссылкам, если ребра нет. */
+	int32_t transition(int32_t state, int32_t code) const {
+		while (view.dense_row[state] < 0) {
+			for (int32_t e = view.edge_begin[state]; e < view.edge_begin[state + 1] && view.edge_codes[e] <= code; e++) {
+				if (view.edge_codes[e] == code) {
+					return view.edge_targets[e];
 				}
 			}
-			else {
-				node->links[c] = node->transitions[c].get();
-			}
+			state = view.failure[state];
 		}
+		return view.table[static_cast <size_t>(view.dense_row[state]) * codes + code];
 	}
 	
 	// Вычисление суффиксной ссылки для вершины node.
 	void make_compressed_link(Node* node) {
-		if (!node->suffix_link->ending_strings.empty()) {
+		if (node->suffix_link->first_ending >= 0) {
 			node->compressed_link = node->suffix_link;
 		}
-		else if (node->suffix_link == root.get()) {
+		else if (node->suffix_link == root) {
 			node->compressed_link = nullptr;
 		}
 		else {
@@ -89,8 +268,156 @@ class Trie {
 	}
 	
 public:
-	Trie(): root(make_unique <Node>()), current(root.get()) {
-		root->parent = root.get();
+	Trie(): root(nullptr), nodes(1), codes(1), view(), mapped(nullptr), mapped_size(0) {
+		root = new (arena.allocate <Node>(1)) Node(nullptr, 0);
+		root->parent = root;
+		symbol_code.fill(0);
+	}
+	
+	~Trie() {
+		if (mapped != nullptr) {
+			munmap(mapped, mapped_size);
+		}
+	}
+	
+	/* Сохранение построенного автомата в файл filename. 
+	   Возвращает false, если записать файл не удалось. */
+	bool save(const string& filename) const {
+		ofstream fout(filename, ios::binary);
+		int32_t header[header_size] = {file_magic, alphabet_size, static_cast <unsigned char>(start_symbol), 
+		                               static_cast <int32_t>(codes), view.states, view.outputs_size, view.rows};
+		auto write = [&](const int32_t* data, size_t count) {
+			fout.write(reinterpret_cast <const char*>(data), count * sizeof(int32_t));
+		};
+		write(header, header_size);
+		write(view.symbol_code, alphabet_size);
+		write(view.dense_row, view.states);
+		write(view.table, static_cast <size_t>(view.rows) * codes);
+		write(view.edge_begin, view.states + 1);
+		write(view.edge_codes, view.states - 1);
+		write(view.edge_targets, view.states - 1);
+		write(view.failure, view.states);
+		write(view.output_begin, view.states + 1);
+		write(view.outputs, view.outputs_size);
+		write(view.output_links, view.states);
+		return static_cast <bool>(fout);
+	}
+	
+	/* Проверка таблиц из файла (data указывает на symbol_code): все коды, переходы и ссылки лежат в своих 
+	   диапазонах, у корня есть полная строка, рёбра каждого состояния отсортированы по коду, 
+	   output_begin не убывает, а суффиксные и сжатые ссылки ведут в состояния с меньшими номерами 
+	   (поэтому ни transition, ни for_each_output не зациклятся). Номера строк проверяются только на 
+	   неотрицательность: сколько строк было в словаре, знает лишь вызывающий. */
+	static bool check_tables(const int32_t* data, int32_t codes, int32_t states, int32_t outputs_size, int32_t rows) {
+		const int32_t* dense_row = data + alphabet_size;
+		const int32_t* table = dense_row + states;
+		const int32_t* edge_begin = table + static_cast <size_t>(rows) * codes;
+		const int32_t* edge_codes = edge_begin + states + 1;
+		const int32_t* edge_targets = edge_codes + states - 1;
+		const int32_t* failure = edge_targets + states - 1;
+		const int32_t* output_begin = failure + states;
+		const int32_t* outputs = output_begin + states + 1;
+		const int32_t* output_links = outputs + outputs_size;
+		for (int i = 0; i < alphabet_size; i++) {
+			if (data[i] < 0 || data[i] >= codes) {
+				return false;
+			}
+		}
+		if (dense_row[0] < 0) {
+			return false;
+		}
+		for (int32_t state = 0; state < states; state++) {
+			if (dense_row[state] < -1 || dense_row[state] >= rows || (state > 0 && (failure[state] < 0 || failure[state] >= state))) {
+				return false;
+			}
+		}
+		size_t table_size = static_cast <size_t>(rows) * codes;
+		for (size_t i = 0; i < table_size; i++) {
+			if (table[i] < 0 || table[i] >= states) {
+				return false;
+			}
+		}
+		if (edge_begin[0] != 0 || edge_begin[states] != states - 1) {
+			return false;
+		}
+		for (int32_t state = 0; state < states; state++) {
+			if (edge_begin[state] > edge_begin[state + 1]) {
+				return false;
+			}
+			for (int32_t e = edge_begin[state]; e < edge_begin[state + 1]; e++) {
+				if (edge_codes[e] < 0 || edge_codes[e] >= codes || (e > edge_begin[state] && edge_codes[e] <= edge_codes[e - 1]) || 
+				    edge_targets[e] < 0 || edge_targets[e] >= states) {
+					return false;
+				}
+			}
+		}
+		if (output_begin[0] != 0 || output_begin[states] != outputs_size) {
+			return false;
+		}
+		for (int32_t state = 0; state < states; state++) {
+			if (output_begin[state] > output_begin[state + 1] || output_links[state] < -1 || output_links[state] >= state) {
+				return false;
+			}
+		}
+		for (int32_t i = 0; i < outputs_size; i++) {
+			if (outputs[i] < 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+	
+	/* Загрузка автомата, сохранённого save, через mmap: файл не копируется в память процесса, 
+	   и все процессы, открывшие один файл, используют одну физическую копию таблиц.
+	   Бор при этом не восстанавливается, доступен только поиск.
+	   Возвращает false, если файл не удалось открыть или он не подходит к этому бору, 
+	   в том числе если таблицы в нём повреждены (см. check_tables). */
+	bool load(const string& filename) {
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat file_stat;
+		if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast <off_t>(header_size * sizeof(int32_t))) {
+			close(fd);
+			return false;
+		}
+		size_t size = static_cast <size_t>(file_stat.st_size);
+		void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) {
+			return false;
+		}
+		const int32_t* header = static_cast <const int32_t*>(data);
+		size_t expected = header_size + alphabet_size + static_cast <size_t>(header[6]) * header[3] + 
+		                  7 * static_cast <size_t>(header[4]) + header[5];
+		if (header[0] != file_magic || header[1] != alphabet_size || 
+		    header[2] != static_cast <unsigned char>(start_symbol) || header[3] <= 0 || header[3] > alphabet_size + 1 || 
+		    header[4] <= 0 || header[5] < 0 || header[6] <= 0 || header[6] > header[4] || expected * sizeof(int32_t) != size || 
+		    !check_tables(header + header_size, header[3], header[4], header[5], header[6])) {
+			munmap(data, size);
+			return false;
+		}
+		if (mapped != nullptr) {
+			munmap(mapped, mapped_size);
+		}
+		mapped = data;
+		mapped_size = size;
+		codes = header[3];
+		view.states = header[4];
+		view.outputs_size = header[5];
+		view.rows = header[6];
+		view.symbol_code = header + header_size;
+		view.dense_row = view.symbol_code + alphabet_size;
+		view.table = view.dense_row + view.states;
+		view.edge_begin = view.table + static_cast <size_t>(view.rows) * codes;
+		view.edge_codes = view.edge_begin + view.states + 1;
+		view.edge_targets = view.edge_codes + view.states - 1;
+		view.failure = view.edge_targets + view.states - 1;
+		view.output_begin = view.failure + view.states;
+		view.outputs = view.output_begin + view.states + 1;
+		view.output_links = view.outputs + view.outputs_size;
+		return true;
 	}
 	
 	// Построение автомата.
@@ -101,62 +428,275 @@ public:
 		}	
 		make_links();
 		make_compressed_links();
+		freeze();
+	}
+	
+	// Построение автомата по словарю keywords; номер слова - его индекс в keywords.
+	void build(const vector <string>& keywords) {
+		int size = static_cast <int>(keywords.size());
+		for (int i = 0; i < size; i++) {
+			add_string(keywords[i], i);
+		}
+		make_links();
+		make_compressed_links();
+		freeze();
+	}
+	
+	/* Словарный поиск: для каждого вхождения каждой строки словаря в text 
+	   вызывает report(номер строки, позиция последнего символа вхождения). 
+	   Вхождения сообщаются в порядке возрастания позиции конца. */
+	template <class Callback>
+	void match(const string& text, Callback report) const {
+		int32_t state = 0;
+		int text_size = static_cast <int>(text.length());
+		for (int i = 0; i < text_size; i++) {
+			state = next_state(state, text[i]);
+			for_each_output(state, [&](int number) { report(number, i); });
+		}
+	}
+	
+	/* То же для набора документов: вызывает report(номер документа, номер строки, позиция конца). 
+	   Автомат не меняется, так что один построенный бор обслуживает сколько угодно документов. */
+	template <class Callback>
+	void match(const vector <string>& documents, Callback report) const {
+		int size = static_cast <int>(documents.size());
+		for (int d = 0; d < size; d++) {
+			match(documents[d], [&](int number, int position) { report(d, number, position); });
+		}
+	}
+	
+	/* Упаковка автомата в непрерывные массивы (см. описание dense_row) и освобождение бора.
+	   Поиск затем идёт только по ним, без обращений к вершинам. */
+	void freeze() {
+		int states = static_cast <int>(state_nodes.size());
+		vector <int32_t> depth(states, 0);
+		dense_row.assign(states, -1);
+		edge_begin.assign(states + 1, 0);
+		edge_codes.clear();
+		edge_targets.clear();
+		failure.assign(states, 0);
+		output_begin.assign(states + 1, 0);
+		output_links.assign(states, -1);
+		outputs.clear();
+		int32_t rows = 0;
+		for (int state = 0; state < states; state++) {
+			Node* node = state_nodes[state];
+			if (state > 0) {
+				depth[state] = depth[node->parent->number] + 1;
+				failure[state] = node->suffix_link->number;
+			}
+			if (depth[state] <= dense_depth || node->edges_count > dense_threshold) {
+				dense_row[state] = rows++;
+			}
+			edge_begin[state] = static_cast <int32_t>(edge_codes.size());
+			for (int i = 0; i < node->edges_count; i++) {
+				edge_codes.push_back(node->edges[i].code);
+				edge_targets.push_back(node->edges[i].child->number);
+			}
+			output_begin[state] = static_cast <int32_t>(outputs.size());
+			for (int32_t j = node->first_ending; j >= 0; j = next_ending[j]) {
+				outputs.push_back(endings[j]);
+			}
+			if (node->compressed_link != nullptr) {
+				output_links[state] = node->compressed_link->number;
+			}
+		}
+		edge_begin[states] = static_cast <int32_t>(edge_codes.size());
+		output_begin[states] = static_cast <int32_t>(outputs.size());
+		table.assign(static_cast <size_t>(rows) * codes, 0);
+		view = {symbol_code.data(), dense_row.data(), table.data(), edge_begin.data(), edge_codes.data(), 
+		        edge_targets.data(), failure.data(), output_begin.data(), outputs.data(), output_links.data(), 
+		        states, static_cast <int32_t>(outputs.size()), rows};
+		/* Полные строки заполняются в порядке обхода в ширину: суффиксная ссылка менее глубокая, 
+		   поэтому переходы из неё (через transition) уже готовы. */
+		for (int state = 0; state < states; state++) {
+			if (dense_row[state] < 0) {
+				continue;
+			}
+			int32_t* row = &table[static_cast <size_t>(dense_row[state]) * codes];
+			for (int c = 0; c < codes && state > 0; c++) {
+				row[c] = transition(failure[state], c);
+			}
+			for (int32_t e = edge_begin[state]; e < edge_begin[state + 1]; e++) {
+				row[edge_codes[e]] = edge_targets[e];
+			}
+		}
+		vector <Node*>().swap(state_nodes);
+		vector <int32_t>().swap(endings);
+		vector <int32_t>().swap(next_ending);
+		arena.clear();
+		root = nullptr;
+	}
+	
+	// Оценка памяти, занимаемой построенным автоматом, в байтах.
+	size_t memory_usage() const {
+		return sizeof(*this) + arena.memory_usage() + 
+		       (dense_row.capacity() + table.capacity() + edge_begin.capacity() + edge_codes.capacity() + 
+		        edge_targets.capacity() + failure.capacity() + output_begin.capacity() + outputs.capacity() + 
+		        output_links.capacity() + endings.capacity() + next_ending.capacity()) * sizeof(int32_t) + 
+		       state_nodes.capacity() * sizeof(Node*);
 	}
 	
 	/* Поиск всех вхождений шаблона в строку text. pattern_length - общая длина шаблона.
 	   Описание вектора patterns приведено в функции solve. 
 	   Возвращает вектор, в котором записаны индексы позиций, где шаблон начинается. */
-	vector <int> search(const vector <pair <string, int> >& patterns, const string& text, int pattern_length) {
+	vector <int> search(const vector <pair <string, int> >& patterns, const string& text, int pattern_length) const {
 		vector <int> start_points;
+		search_range(patterns, text, pattern_length, 0, static_cast <int>(text.length()), start_points);
+		return start_points;
+	}
+	
+	/* То же, что search, но текст делится на threads кусков, которые обрабатываются параллельно.
+	   Автомат при этом только читается, так что все потоки используют один и тот же бор. */
+	vector <int> parallel_search(const vector <pair <string, int> >& patterns, const string& text, 
+	                             int pattern_length, int threads) const {
 		int text_size = static_cast <int>(text.length());
-		// occurrences[i] - кол-во отметок о вхождениях на i-й позиции.
-		vector <int> occurrences(text_size, 0);
-		for (int i = 0; i < text_size; i++) {
-			change_state(text[i]);
-			check_occurrences(patterns, occurrences, i);
+		// слишком маленькие куски не окупают запуск потока
+		const int min_chunk = 1 << 16;
+		int chunk = max((text_size + threads - 1) / max(threads, 1), min_chunk);
+		int chunks = (text_size + chunk - 1) / chunk;
+		if (chunks <= 1) {
+			return search(patterns, text, pattern_length);
 		}
-		for (int i = 0; i < text_size; i++) {
-			if (occurrences[i] == static_cast <int>(patterns.size()) && i + pattern_length - 1 < text_size) {
-				start_points.push_back(i);
+		vector <vector <int> > chunk_points(chunks);
+		vector <thread> workers;
+		for (int k = 0; k < chunks; k++) {
+			workers.emplace_back([&, k]() {
+				search_range(patterns, text, pattern_length, k * chunk, min(text_size, (k + 1) * chunk), chunk_points[k]);
+			});
+		}
+		for (auto& worker: workers) {
+			worker.join();
+		}
+		// куски идут подряд, поэтому достаточно склеить ответы по порядку
+		vector <int> start_points;
+		for (auto& points: chunk_points) {
+			start_points.insert(start_points.end(), points.begin(), points.end());
+		}
+		return start_points;
+	}
+	
+	/* Потоковый поиск: текст (первое слово во входе in) читается кусками по buffer_size символов,
+	   а начала вхождений выводятся в out, как только становятся окончательными.
+	   Вместо вектора occurrences на весь текст хранятся только pattern_length счётчиков по кругу:
+	   отметки ставятся лишь на последние pattern_length позиций, а позиция, отставшая 
+	   на pattern_length - 1 символ, больше не изменится, и её счётчик можно переиспользовать. */
+	void stream_search(const vector <pair <string, int> >& patterns, istream& in, ostream& out, 
+	                   int pattern_length) const {
+		const int buffer_size = 1 << 16;
+		vector <char> buffer(buffer_size);
+		// counters[p % pattern_length] - кол-во отметок о вхождениях на p-й позиции
+		vector <int> counters(pattern_length, 0);
+		int required = static_cast <int>(patterns.size());
+		int32_t state = 0;
+		long long position = 0;
+		// position % pattern_length
+		int slot = 0;
+		bool started = false;
+		while (in) {
+			in.read(buffer.data(), buffer_size);
+			int received = static_cast <int>(in.gcount());
+			for (int i = 0; i < received; i++) {
+				if (isspace(static_cast <unsigned char>(buffer[i]))) {
+					if (started) {
+						return;
+					}
+					continue;
+				}
+				started = true;
+				state = next_state(state, buffer[i]);
+				for_each_output(state, [&](int number) {
+					int back = patterns[number].second;
+					if (position >= back) {
+						counters[slot >= back ? slot - back : slot - back + pattern_length]++;
+					}
+				});
+				// позиция position - pattern_length + 1 больше отметок не получит
+				slot = (slot + 1 == pattern_length ? 0 : slot + 1);
+				if (position >= pattern_length - 1) {
+					if (counters[slot] == required) {
+						out << position - pattern_length + 1 << " ";
+					}
+					counters[slot] = 0;
+				}
+				position++;
 			}
 		}
-		// Проверка особого случая, когда в шаблоне только вопросики.
-		if (patterns.empty()) {
-			for (int i = 0; i + pattern_length - 1 < text_size; i++) {
+	}
+	
+	/* Дописывает в start_points вхождения шаблона, начинающиеся в позициях [begin, end) строки text.
+	   Автомат запускается из корня с позиции begin и доходит до позиции end + pattern_length - 2, 
+	   т.е. соседние куски перекрываются на pattern_length - 1 символ: этого достаточно, 
+	   чтобы увидеть все подстроки шаблона, относящиеся к началам из [begin, end). */
+	void search_range(const vector <pair <string, int> >& patterns, const string& text, int pattern_length, 
+	                  int begin, int end, vector <int>& start_points) const {
+		int text_size = static_cast <int>(text.length());
+		int last = min(text_size, end + pattern_length - 1);
+		// occurrences[i] - кол-во отметок о вхождениях на (begin + i)-й позиции.
+		vector <int> occurrences(max(end - begin, 0), 0);
+		int32_t state = 0;
+		for (int i = begin; i < last; i++) {
+			state = next_state(state, text[i]);
+			check_occurrences(patterns, occurrences, state, i, begin);
+		}
+		for (int i = begin; i < end; i++) {
+			// Особый случай, когда в шаблоне только вопросики, сюда тоже подходит.
+			if (occurrences[i - begin] == static_cast <int>(patterns.size()) && i + pattern_length - 1 < text_size) {
 				start_points.push_back(i);
 			}
 		}
-		return start_points;
 	}
 	
 	// Добавление в бор строки pattern, которая суть patterns[number].first.
 	void add_string(const string& pattern, int number) {
-		Node* state = root.get();
 		int size = static_cast <int> (pattern.length());
 		for (int i = 0; i < size; i++) {
-			if (state->transitions[pattern[i] - start_symbol] == nullptr) {
-				state->transitions[pattern[i] - start_symbol] = make_unique <Node>(state, pattern[i]);
+			if (symbol_index(pattern[i]) >= alphabet_size) {
+				return;
+			}
+		}
+		Node* state = root;
+		for (int i = 0; i < size; i++) {
+			int32_t& code = symbol_code[symbol_index(pattern[i])];
+			if (code == 0) {
+				code = codes++;
+			}
+			Node* next = state->child(code);
+			if (next == nullptr) {
+				next = state->add_child(code, arena);
+				nodes++;
 			}
-			state = state->transitions[pattern[i] - start_symbol].get();
+			state = next;
 			if (i == size - 1) {
-				state->ending_strings.push_back(number); 
+				int32_t ending = static_cast <int32_t>(endings.size());
+				endings.push_back(number);
+				next_ending.push_back(-1);
+				if (state->last_ending >= 0) {
+					next_ending[state->last_ending] = ending;
+				}
+				else {
+					state->first_ending = ending;
+				}
+				state->last_ending = ending;
 			}
 		}
 	}
 	
-	// Вычисление переходов для бора в целом (обходом в ширину).
+	/* Вычисление суффиксных ссылок для бора в целом (обходом в ширину).
+	   Вершины нумеруются в порядке обхода, state_nodes запоминает их для freeze. */
 	void make_links() {
+		state_nodes.clear();
+		state_nodes.reserve(nodes);
 		queue <Node*> q;
-		q.push(root.get());
+		q.push(root);
 		while (!q.empty()) {
 			auto vertex = q.front();
-			for (int i = 0; i < alphabet_size; i++) {
-				if (vertex->transitions[i] != nullptr) {
-					q.push(vertex->transitions[i].get());
-				}
-			}
+			vertex->number = static_cast <int32_t>(state_nodes.size());
+			state_nodes.push_back(vertex);
 			make_suffix_link(vertex);
-			make_links(vertex);
+			for (int i = 0; i < vertex->edges_count; i++) {
+				q.push(vertex->edges[i].child);
+			}
 			q.pop();
 		}
 	}
@@ -164,35 +704,42 @@ public:
 	// Вычисление сжатых суффиксных ссылок для бора в целом (обходом в ширину).
 	void make_compressed_links() {
 		queue <Node*> q;
-		q.push(root.get());
+		q.push(root);
 		while (!q.empty()) {
 			auto vertex = q.front();
-			for (int i = 0; i < alphabet_size; i++) {
-				if (vertex->transitions[i] != nullptr) {
-					q.push(vertex->transitions[i].get());
-				}
+			for (int i = 0; i < vertex->edges_count; i++) {
+				q.push(vertex->edges[i].child);
 			}
 			make_compressed_link(vertex);
 			q.pop();
 		}
 	}
 	
-	// Изменение состояния бора, если нужно обработать символ c.
-	void change_state(char c) {
-		current = current->links[c - start_symbol];
+	// Переход автомата из состояния state по символу c.
+	int32_t next_state(int32_t state, char c) const {
+		return transition(state, symbol_code_of(view.symbol_code, c));
 	}
 	
-	/* Проверяет и отмечает все вхождения подстрок шаблона, 
-	   хранящихся в векторе patterns, заканчивающихся в позиции position. */
-	void check_occurrences(const vector <pair <string, int> >& patterns, vector <int>& occurrences, int position) {
-		Node* link = current;
-		while (link != nullptr && link != root.get()) {
-			for (auto x: link->ending_strings) {
-				if (position - patterns[x].second >= 0) {
-					occurrences[position - patterns[x].second]++;
-				}
+	/* Проверяет и отмечает все вхождения подстрок шаблона, хранящихся в векторе patterns, 
+	   заканчивающихся в позиции position (автомат при этом находится в состоянии state).
+	   occurrences[i] отвечает позиции offset + i. */
+	void check_occurrences(const vector <pair <string, int> >& patterns, vector <int>& occurrences, 
+	                       int32_t state, int position, int offset) const {
+		for_each_output(state, [&](int number) {
+			int start = position - patterns[number].second - offset;
+			if (start >= 0 && start < static_cast <int>(occurrences.size())) {
+				occurrences[start]++;
+			}
+		});
+	}
+	
+	// Вызывает f(номер строки) для всех строк, заканчивающихся в состоянии state (с учётом сжатых ссылок).
+	template <class Function>
+	void for_each_output(int32_t state, Function f) const {
+		for (int32_t link = state; link > 0; link = view.output_links[link]) {
+			for (int32_t j = view.output_begin[link]; j < view.output_begin[link + 1]; j++) {
+				f(view.outputs[j]);
 			}
-			link = link->compressed_link;
 		}
 	}
 	
@@ -202,16 +749,27 @@ public:
 
 
 // Поиск всех вхождений подстрок шаблона из patterns в строке text.
-// Реализует алгоритм Ахо-Корасик.
-vector <int> patterns_search(const vector <pair <string, int> >& patterns, const string& text, int pattern_length) {
+// Реализует алгоритм Ахо-Корасик. Текст обрабатывается в threads потоков.
+vector <int> patterns_search(const vector <pair <string, int> >& patterns, const string& text, int pattern_length, 
+                             int threads = 1) {
 	// строим бор на имеющихся подстроках
-	Trie trie;
-	vector <int> start_points;
+	Trie <> trie;
 	trie.build(patterns);
+	if (threads > 1) {
+		return trie.parallel_search(patterns, text, pattern_length, threads);
+	}
 	return trie.search(patterns, text, pattern_length);
 }
 
 
+// То же, что patterns_search, но текст читается из in по частям, а ответ сразу пишется в out.
+void stream_patterns_search(const vector <pair <string, int> >& patterns, istream& in, ostream& out, int pattern_length) {
+	Trie <> trie;
+	trie.build(patterns);
+	trie.stream_search(patterns, in, out, pattern_length);
+}
+
+
 // Выделение из шаблона pattern подстрок patterns, вхождения которых потом будут проверяться.
 // Описание вектора patterns приведено в функции solve.
 void pattern_split(const string& pattern, vector <pair <string, int> >& patterns) {
@@ -238,18 +796,17 @@ void pattern_split(const string& pattern, vector <pair <string, int> >& patterns
 
 // Функция для решения.
 void solve() {
-	string pattern, text;
+	string pattern;
 	/* Первый элемент - подстрока шаблона (между вопросиками), второй - на сколько символов назад нужно отметить вхождение.
 	   Т.е., если строка patterns[i].first вошла в текст и закончилась на j-м его символе, 
 	   вхождение будет отмечено для j - patterns[i].second символа. Тогда вхождению всего шаблона
 	   будут соответствовать patterns.size() таких отметок в позиции, где этот шаблон начинается. */
 	vector <pair <string, int> > patterns;
-	cin >> pattern >> text;
+	cin >> pattern;
 	// размер шаблона, сколько вопросиков было до текущего момента, сколько иных символов было до текущего момента.
 	pattern_split(pattern, patterns);
-	vector <int> pattern_entries = patterns_search(patterns, text, static_cast <int>(pattern.length()));
-	for (auto i: pattern_entries)
-		cout << i << " ";
+	// текст не сохраняется целиком, а обрабатывается по мере чтения
+	stream_patterns_search(patterns, cin, cout, static_cast <int>(pattern.length()));
 }
 
                                                                                                                           
@@ -1,7 +1,13 @@
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "suffix array.h"
+
 using namespace std;
 
 /* Символы-разделители, не встречающиеся в строках.
@@ -15,138 +21,331 @@ using namespace std;
 const char special_symbol_1 = '$';
 const char special_symbol_2 = '#';
 const int alphabet_size = 97;
+const Alphabet alphabet = {special_symbol_2, alphabet_size};
 
-/* Модифицирует массив, получившийся после подсчёта, так, чтобы count[i] 
- * хранил позицию, в которую нужно начинать ставить элементы с ключом i.
- * Изначально count[i] - количество элементов с ключом i. */
-void count_positions(vector <int>& count) {
-	if (count.empty())
-		return;
-	int last = count[0];
-	count[0] = 0;
-	for (int i = 1; i < static_cast <int>(count.size()); i++) {
-		int temp = count[i];
-		count[i] = last;
-		last += temp;
+/* Обобщённый суффиксный массив нескольких документов. Документы записываются подряд как числа:
+ * символ c - как documents + (unsigned char)c, а после документа d ставится разделитель documents - 1 - d.
+ * Так в строках нет зарезервированных символов, разделители попарно различны (lcp через них не переходит),
+ * а последний из них - единственный нулевой, как и нужно для SA-IS. Все запросы ниже делаются 
+ * одним проходом по уже построенным suf и lcp, без перестроений для разных наборов документов. */
+class GeneralizedSuffixArray {
+	int count;
+	// owner[p] - документ, которому принадлежит позиция p, ends[d] - позиция разделителя после документа d
+	vector <int> text, owner, ends, suf, lcp;
+	
+	// длина суффикса suf[i] до ближайшего разделителя
+	int length(int i) const {
+		return ends[owner[suf[i]]] - suf[i];
 	}
-}
-
-// Построение суффиксного массива suf (изначально заполнен нулями) по строке s.
-void build_suffix_array(const string& s, vector <int>& suf) {
-	const int size = static_cast <int>(s.length());
-	// вспомогательный массив для сортировки подсчётом
-	vector <int> count(alphabet_size, 0);
-	// классы эквивалентности суффиксов по первым символам
-	vector <int> classes(size, 0);
-	for (int i = 0; i < size; i++)
-		count[s[i] - special_symbol_2]++;
-	count_positions(count);
-	for (int i = 0; i < size; i++)
-		suf[count[s[i] - special_symbol_2]++] = i;
-	char current_char = special_symbol_2;
-	int current_class = 0;
-	// определяем классы эквивалентности для первого этапа сортировки
-	for (int i = 0; i < size; i++) {
-		if (s[suf[i]] != current_char) {
-			current_char = s[suf[i]];
-			current_class++;
+	
+	/* Для каждого i по порядку вызывает f(i, common), где common - длина наибольшего префикса suf[i]-го суффикса,
+	 * встречающегося во всех документах subset. Такие префиксы образуют отрезок суффиксного массива [i, j], 
+	 * в котором есть суффиксы всех документов subset, а с ростом i наименьшее такое j не убывает, 
+	 * поэтому его можно вести двумя указателями, а минимум lcp на (i, j] - очередью с минимумом. */
+	template <class Function>
+	void for_each_common(const vector <int>& subset, Function f) const {
+		const int size = static_cast <int>(suf.size());
+		vector <char> needed(count, 0);
+		vector <int> in_window(count, 0);
+		int required = 0, covered = 0;
+		for (int document : subset) {
+			if (!needed[document])
+				required++;
+			needed[document] = 1;
+		}
+		auto add = [&](int i) {
+			int document = owner[suf[i]];
+			if (needed[document] && length(i) > 0 && in_window[document]++ == 0)
+				covered++;
+		};
+		vector <int> window_min(size);
+		int head = 0, tail = 0;
+		int j = -1;
+		for (int i = 0; i < size; i++) {
+			while (head < tail && window_min[head] <= i)
+				head++;
+			if (j < i) {
+				j = i;
+				add(i);
+			}
+			while (covered < required && j + 1 < size) {
+				j++;
+				add(j);
+				while (head < tail && lcp[window_min[tail - 1]] >= lcp[j])
+					tail--;
+				window_min[tail++] = j;
+			}
+			int common = 0;
+			if (covered == required)
+				common = head < tail ? min(length(i), lcp[window_min[head]]) : length(i);
+			f(i, common);
+			int document = owner[suf[i]];
+			if (needed[document] && length(i) > 0 && --in_window[document] == 0)
+				covered--;
 		}
-		classes[suf[i]] = current_class;
 	}
 	
-	int current_length = 1;
-	// сортируем по первым current_length символам
-	while (current_length < size) {
-		// сортировка по 2 половине
-		vector <int> sufs_by_2nd_half(size, 0);
-		for (int i = 0; i < size; i++) {
-			sufs_by_2nd_half[i] = (suf[i] - current_length + size) % size;
+public:
+	GeneralizedSuffixArray(): count(0) {}
+	
+	void build(const vector <string>& documents) {
+		count = static_cast <int>(documents.size());
+		text.clear();
+		owner.clear();
+		ends.assign(count, 0);
+		for (int d = 0; d < count; d++) {
+			for (char c : documents[d]) {
+				text.push_back(count + static_cast <unsigned char>(c));
+				owner.push_back(d);
+			}
+			ends[d] = static_cast <int>(text.size());
+			text.push_back(count - 1 - d);
+			owner.push_back(d);
 		}
+		const int size = static_cast <int>(text.size());
+		suf.assign(size, 0);
+		lcp.assign(size, 0);
+		if (size > 0) {
+			sa_is(ReducedSymbols{text.data()}, suf.data(), size, count + 256);
+			build_lcp(text, suf, lcp);
+		}
+	}
+	
+	int documents() const {
+		return count;
+	}
 	
-		// сортировка по 1 половине
-		count.assign(size, 0);
-		for (int i = 0; i < size; i++)
-			count[classes[sufs_by_2nd_half[i]]]++;
-		count_positions(count);
-		for (int i = 0; i < size; i++)
-			suf[count[classes[sufs_by_2nd_half[i]]]++] = sufs_by_2nd_half[i];
-			
-		// определение новых классов эквивалентности
-		vector <int> new_classes(size, 0);
-		current_class = 0;
+	/* Количество различных подстрок каждого документа. Для документа d это сумма по его суффиксам 
+	 * длин без lcp с предыдущим суффиксом того же документа; этот lcp - минимум lcp на отрезке 
+	 * между ними, он ищется двоичным поиском в стеке возрастающих lcp. Всего O(n log n). */
+	vector <long long> distinct_substrings() const {
+		const int size = static_cast <int>(suf.size());
+		vector <long long> result(count, 0);
+		vector <int> last(count, -1);
+		vector <int> stack;
 		for (int i = 0; i < size; i++) {
-			new_classes[suf[i]] = current_class;
-			if (i < size - 1 && (classes[suf[i]] != classes[suf[i + 1]] || 
-				classes[(suf[i] + current_length) % size] != classes[(suf[i + 1] + current_length) % size]))
-				current_class++;
+			if (i > 0) {
+				while (!stack.empty() && lcp[stack.back()] >= lcp[i])
+					stack.pop_back();
+				stack.push_back(i);
+			}
+			if (length(i) == 0)
+				continue;
+			int document = owner[suf[i]];
+			int common = 0;
+			if (last[document] >= 0)
+				common = lcp[*upper_bound(stack.begin(), stack.end(), last[document])];
+			result[document] += length(i) - common;
+			last[document] = i;
 		}
-		classes = new_classes;
-		current_length *= 2;
+		return result;
 	}
-}
-
-// Построение массива lcp алгоритмом Касаи и др., за линейное время.
-// В данной реализации lcp[i] - длина наибольшего общего префикса suf[i] и suf[i - 1]-го суффиксов.
-void build_lcp (const string& s, const vector <int>& suf, vector <int>& lcp) {
-	const int size = static_cast <int>(s.length());
-	vector <int> positions(size, 0);
-	for (int i = 0; i < size; i++)
-		positions[suf[i]] = i;
-	int current_lcp = 0;
-	for (int i = 0; i < size; i++) {
-		if (current_lcp > 0)
-			current_lcp--;
-		if (positions[i] > 0) {
-			int k = suf[positions[i] - 1];
-			while (i + current_lcp < size && k + current_lcp < size && 
-				   s[i + current_lcp] == s[k + current_lcp])
-				current_lcp++;
-			lcp[positions[i]] = current_lcp;
-		}
-		else {
-			current_lcp = 0;
-			lcp[0] = -1;
-		}
+	
+	/* Наибольшая общая подстрока документов subset (если их несколько, то лексикографически наименьшая).
+	 * Пустая строка, если общих подстрок нет. */
+	string longest_common_substring(const vector <int>& subset) const {
+		int best = 0, position = 0;
+		for_each_common(subset, [&](int i, int common) {
+			if (common > best) {
+				best = common;
+				position = suf[i];
+			}
+		});
+		return substring(position, best);
 	}
-}
+	
+	/* k-я в лексикографическом порядке различная подстрока, общая для документов subset.
+	 * Новые различные подстроки у suf[i]-го суффикса - его префиксы длиннее lcp[i], и общими из них 
+	 * являются префиксы длины не больше common. Возвращает {false, ""}, если столько общих подстрок нет. */
+	pair <bool, string> kth_common_substring(const vector <int>& subset, long long number) const {
+		long long current_sum = 0;
+		bool found = false;
+		string result;
+		for_each_common(subset, [&](int i, int common) {
+			int previous = max(lcp[i], 0);
+			if (found || common <= previous)
+				return;
+			if (current_sum + (common - previous) >= number) {
+				found = true;
+				result = substring(suf[i], static_cast <int>(previous + (number - current_sum)));
+			}
+			current_sum += common - previous;
+		});
+		return {found, result};
+	}
+	
+	string substring(int position, int length) const {
+		string result(length, '\0');
+		for (int i = 0; i < length; i++)
+			result[i] = static_cast <char>(text[position + i] - count);
+		return result;
+	}
+};
 
 /* Определяет тип суффикса suf[suffix_position] в суффиксном массиве, 
  * т.е. то, к которой из строк данный суффикс относится. */
-int type (int suffix_position, long long s_length) {
+int type (long long suffix_position, long long s_length) {
 	return (suffix_position < s_length ? 0 : 1);
 }
 
-/* Функция для решения задачи. Возвращает пару вида {true, подстрока}, 
- * если подстрока с требуемым номером нашлась, и {false, ""} в противном случае. */
-pair <bool, string> common_substring_search(const string& first_string, const string& second_string, long long number) {
-	int first_length = static_cast <int>(first_string.length());
-	string concat = first_string + special_symbol_1 + second_string + special_symbol_2;
-	int size = static_cast <int>(concat.length());
-	vector <int> suf(concat.length(), 0), lcp(concat.length(), 0);
-	build_suffix_array(concat, suf);
-	build_lcp(concat, suf, lcp);
+/* Проход по индексу, построенному по строке s$t#, в котором появляются новые общие подстроки в лексикографическом порядке.
+ * Для каждого места i, где они есть, вызывает f(i, base, count): новые общие подстроки - это префиксы suf[i]-го суффикса 
+ * длин base + 1, ..., base + count. Если f вернёт false, проход останавливается. */
+template <class Function>
+void walk_common_substrings(const SuffixIndex& index, Function f) {
+	int size = index.size();
+	int first_length = static_cast <int>(find(index.text(), index.text() + size, special_symbol_1) - index.text());
 	
 	/* Если суффиксы относятся к разным строкам, их общими префиксами будут общие подстроки первой и второй строк.
 	 * Чтобы не учитывать их многократно, нужно всякий раз вычитать кол-во уже учтённых ранее подстрок, равное last_lcp. */
-	long long current_sum = 0;
 	int last_lcp = 0;
 	for (int i = 0; i < size - 1; i++) {
-		if (type(suf[i], first_length) != type(suf[i + 1], first_length)) {
-			last_lcp = min(last_lcp, lcp[i + 1]);
-			current_sum += lcp[i + 1] - last_lcp;
-			if (current_sum >= number) {
-				long long addition = number - (current_sum - (lcp[i + 1] - last_lcp));
-				return {true, concat.substr(suf[i], last_lcp + addition)};
-			}
-			last_lcp = lcp[i + 1];
+		int next_lcp = index.lcp(i + 1);
+		if (type(index.suffix(i), first_length) != type(index.suffix(i + 1), first_length)) {
+			last_lcp = min(last_lcp, next_lcp);
+			if (next_lcp > last_lcp && !f(i, last_lcp, next_lcp - last_lcp))
+				return;
+			last_lcp = next_lcp;
 		}
 		else {
-			last_lcp = min(last_lcp, lcp[i + 1]);
+			last_lcp = min(last_lcp, next_lcp);
+		}
+	}
+}
+
+/* Поиск k-й общей подстроки по индексу, построенному по строке s$t#. Возвращает пару вида {true, подстрока}, 
+ * если подстрока с требуемым номером нашлась, и {false, ""} в противном случае. */
+pair <bool, string> common_substring_search(const SuffixIndex& index, long long number) {
+	long long current_sum = 0;
+	pair <bool, string> result = {false, ""};
+	walk_common_substrings(index, [&](int i, int base, int count) {
+		if (current_sum + count >= number) {
+			result = {true, index.substring(index.suffix(i), static_cast <int>(base + (number - current_sum)))};
+			return false;
+		}
+		current_sum += count;
+		return true;
+	});
+	return result;
+}
+
+/* Много запросов k-й общей подстроки к одному индексу: проход walk_common_substrings делается один раз, 
+ * и для каждого места с новыми подстроками запоминается их общее количество до него включительно. 
+ * Тогда запрос - двоичный поиск по этим суммам за O(log n), а упорядоченные запросы - один проход. */
+class CommonSubstringQueries {
+	const SuffixIndex& index;
+	// места в суффиксном массиве, длины base и количества общих подстрок до них включительно
+	vector <int> rows, bases;
+	vector <long long> totals;
+	
+	// ответ по месту step, если подстрока с номером number из него
+	pair <bool, string> answer(size_t step, long long number) const {
+		long long before = step == 0 ? 0 : totals[step - 1];
+		return {true, index.substring(index.suffix(rows[step]), static_cast <int>(bases[step] + (number - before)))};
+	}
+	
+public:
+	explicit CommonSubstringQueries(const SuffixIndex& index): index(index) {
+		long long current_sum = 0;
+		walk_common_substrings(index, [&](int i, int base, int count) {
+			current_sum += count;
+			rows.push_back(i);
+			bases.push_back(base);
+			totals.push_back(current_sum);
+			return true;
+		});
+	}
+	
+	// количество различных общих подстрок
+	long long total() const {
+		return totals.empty() ? 0 : totals.back();
+	}
+	
+	// k-я общая подстрока в том же виде, что и у common_substring_search
+	pair <bool, string> find(long long number) const {
+		if (number < 1 || number > total())
+			return {false, ""};
+		return answer(lower_bound(totals.begin(), totals.end(), number) - totals.begin(), number);
+	}
+	
+	/* Ответы на запросы numbers в любом порядке. Упорядоченные по неубыванию запросы обрабатываются 
+	 * за один проход по суммам, а если номер меньше предыдущего, место ищется двоичным поиском назад. */
+	vector <pair <bool, string>> find_all(const vector <long long>& numbers) const {
+		vector <pair <bool, string>> result;
+		result.reserve(numbers.size());
+		size_t step = 0;
+		for (long long number : numbers) {
+			if (number < 1 || number > total()) {
+				result.push_back({false, ""});
+				continue;
+			}
+			if (step > 0 && totals[step - 1] >= number)
+				step = lower_bound(totals.begin(), totals.begin() + step, number) - totals.begin();
+			while (totals[step] < number)
+				step++;
+			result.push_back(answer(step, number));
 		}
+		return result;
 	}
-	return {false, ""};
+};
+
+/* Функция для решения задачи. Возвращает пару вида {true, подстрока}, 
+ * если подстрока с требуемым номером нашлась, и {false, ""} в противном случае.
+ * Если threads > 1, суффиксный массив и lcp строятся в threads потоков. */
+pair <bool, string> common_substring_search(const string& first_string, const string& second_string, long long number, 
+                                            int threads = 1) {
+	SuffixIndex index;
+	index.build(first_string + special_symbol_1 + second_string + special_symbol_2, alphabet, threads);
+	return common_substring_search(index, number);
 }
 
+/* Поиск k-й общей подстроки строк из файлов first_filename и second_filename с построением 
+ * суффиксного массива и lcp во внешней памяти (см. build_suffix_array_external) - тот же проход, 
+ * что и в common_substring_search, по двум файлам. Файлы читаются подряд (кроме найденной подстроки) 
+ * и могут не помещаться в память. Возвращает false, если файл не открылся 
+ * или не хватило места на диске; иначе ответ в result в том же виде, что и у common_substring_search. */
+bool common_substring_search_external(const string& first_filename, const string& second_filename, long long number, 
+                                      pair <bool, string>& result, size_t memory_limit = size_t(1) << 30, 
+                                      const string& directory = "/tmp") {
+	ExternalText text;
+	if (!text.add(first_filename, special_symbol_1) || !text.add(second_filename, special_symbol_2))
+		return false;
+	result = {false, ""};
+	try {
+		unique_ptr <TemporaryFile> suf = build_suffix_array_external(text, alphabet, memory_limit, directory);
+		unique_ptr <TemporaryFile> lcp = build_lcp_external(text, *suf, memory_limit, directory);
+		RecordReader <int64_t> suf_reader(*suf), lcp_reader(*lcp);
+		const int64_t first_length = text.first_size();
+		int64_t current = 0, next = 0, next_lcp = 0;
+		suf_reader.next(current);
+		lcp_reader.next(next_lcp);
+		long long current_sum = 0;
+		int64_t last_lcp = 0;
+		while (suf_reader.next(next) && lcp_reader.next(next_lcp)) {
+			if (type(current, first_length) != type(next, first_length)) {
+				last_lcp = min(last_lcp, next_lcp);
+				current_sum += next_lcp - last_lcp;
+				if (current_sum >= number) {
+					long long addition = number - (current_sum - (next_lcp - last_lcp));
+					string substring(static_cast <size_t>(last_lcp + addition), '\0');
+					for (size_t i = 0; i < substring.length(); i++)
+						substring[i] = text[current + static_cast <int64_t>(i)];
+					result = {true, substring};
+					break;
+				}
+				last_lcp = next_lcp;
+			}
+			else {
+				last_lcp = min(last_lcp, next_lcp);
+			}
+			current = next;
+		}
+	}
+	catch (const runtime_error&) {
+		return false;
+	}
+	return true;
+}
 
 void solve() {
 	string first_string, second_string;
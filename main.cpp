@@ -1,8 +1,9 @@
 /* Найти лексикографически минимальную строку, 
  * построенную по префикс-функции, в алфавите a-z.*/
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
-#include <queue>
 #include <vector>
 
 using namespace std;
@@ -12,29 +13,30 @@ const char start_symbol = 'a';
 
 // Построение лексикографически минимальной строки по префикс-функции.
 string prefix_to_string(const vector <int>& prefix) {
-	string result = "";
-	result.push_back(start_symbol);
-	for (int i = 1; i < static_cast <int>(prefix.size()); i++) {
+	const int size = static_cast <int>(prefix.size());
+	string result(max(size, 1), start_symbol);
+	/* continuations[k] - маска символов, которыми продолжаются префикс длины k и все его границы:
+	 * result[k], result[prefix[k - 1]], ..., result[0]. Если prefix[i] = 0, то ни один из потенциально возможных 
+	 * суффиксов нельзя продолжить, т.е. запрещены ровно символы из continuations[prefix[i - 1]].
+	 * Маска наследуется по префикс-функции, поэтому цепочку границ обходить не нужно, и всё построение линейно 
+	 * при любом входе, а не только амортизированно на настоящих префикс-функциях. */
+	vector <uint32_t> continuations(max(size, 1), 0);
+	continuations[0] = 1;
+	for (int i = 1; i < size; i++) {
+		uint32_t border_continuations = continuations[prefix[i - 1]];
+		int symbol;
 		if (prefix[i])
-			result += result[prefix[i] - 1];
+			symbol = result[prefix[i] - 1] - start_symbol;
 		else {
-			// хочется, чтобы ни один из потенциально возможных суффиксов нельзя было продолжить.
-			// переберём их и пометим символы после них как "forbidden" - запрещённые. 
-			// В конце выберем первый не запрещённый символ.
-			vector <bool> forbidden(alphabet_size, 0);
-			int current = prefix[i - 1];
-			while (current > 0) {
-				forbidden[result[current] - start_symbol] = true;
-				current = prefix[current - 1];
-			}
-			forbidden[result[current] - start_symbol] = true;
-			for (int i = 0; i < alphabet_size; i++) {
-				if (!forbidden[i]) {
-					result += start_symbol + i;
-					break;
-				}
+			// заняты все символы алфавита - массив не является префикс-функцией
+			if (border_continuations == (1u << alphabet_size) - 1) {
+				result.resize(i);
+				break;
 			}
+			symbol = __builtin_ctz(~border_continuations);
 		}
+		result[i] = static_cast <char>(start_symbol + symbol);
+		continuations[i] = (1u << symbol) | border_continuations;
 	}
 	return result;
 }
@@ -43,18 +45,15 @@ string prefix_to_string(const vector <int>& prefix) {
 // Преобразование z-функции некоторой строки в её префикс-функцию.
 void z_to_prefix(vector <int>& prefix, const vector <int>& z) {
 	int size = static_cast <int>(z.size());
-	prefix.clear();
-	prefix.resize(size, 0);
-	queue <pair <int, int> > segments;
+	prefix.assign(size, 0);
+	/* z-функция задаёт некоторые "отрезки" - подстроки, совпадающие с префиксами.
+	   Префикс-функция в позиции k равна длине префикса самого левого из отрезков, содержащих k-й символ.
+	   Поэтому отрезки перебираются слева направо, и каждый заполняет свои позиции с конца, пока 
+	   не дойдёт до уже заполненной более левым отрезком: левее неё всё тоже заполнено. 
+	   Каждая позиция записывается один раз, так что всё линейно и без дополнительной памяти.*/
 	for (int i = 1; i < size; i++) {
-		while (!segments.empty() && segments.front().first + segments.front().second <= i)
-			segments.pop();
-		if (z[i])
-			segments.push({i, z[i]});
-		if (!segments.empty())
-			prefix[i] = i - segments.front().first + 1;
-		else
-			prefix[i] = 0;
+		for (int j = min(z[i], size - i) - 1; j >= 0 && prefix[i + j] == 0; j--)
+			prefix[i + j] = j + 1;
 	}
 }
 
@@ -91,16 +90,176 @@ string z_to_string(const vector <int>& z) {
 
 // Преобразование префикс-функции некоторой строки в её z-функцию.
 void prefix_to_z(const vector <int>& prefix, vector <int>& z) {
-	string auxiliary_string = prefix_to_string(prefix);
-	z_function(auxiliary_string, z);
+	int size = static_cast <int>(prefix.size());
+	z.assign(size, 0);
+	if (size == 0)
+		return;
+	/* Граница длины prefix[i], оканчивающаяся в i, - это совпадение с префиксом, начинающееся в i - prefix[i] + 1; 
+	 * при равных началах большие i записываются позже, так что остаётся наибольшая длина. 
+	 * Совпадения, которые не видны из префикс-функции (их конец покрыт более длинной границей), лежат внутри 
+	 * уже найденного отрезка [i, i + z[i]) и восстанавливаются копированием: z[i + j] = min(z[j], z[i] - j), 
+	 * пока внутри не встретится отрезок длиннее скопированного - с него и продолжаем. 
+	 * Каждая позиция заполняется один раз, без вспомогательной строки. */
+	for (int i = 1; i < size; i++)
+		if (prefix[i] > 0)
+			z[i - prefix[i] + 1] = prefix[i];
+	z[0] = size;
+	int i = 1;
+	while (i < size) {
+		int next = i + 1;
+		for (int j = 1; j < z[i] && z[i + j] <= z[j]; j++) {
+			z[i + j] = min(z[j], z[i] - j);
+			next = i + j + 1;
+		}
+		i = next;
+	}
 }
 
 
-// Вычисляет префикс-функцию prefix строки text.
+// Вычисляет префикс-функцию prefix строки text алгоритмом Кнута-Морриса-Пратта.
 void prefix_function(const string& text, vector <int>& prefix) {
-	vector <int> z;
-	z_function(text, z);
-	z_to_prefix(prefix, z);
+	int size = static_cast <int>(text.length());
+	prefix.assign(size, 0);
+	for (int i = 1; i < size; i++) {
+		int border = prefix[i - 1];
+		while (border > 0 && text[i] != text[border])
+			border = prefix[border - 1];
+		if (text[i] == text[border])
+			border++;
+		prefix[i] = border;
+	}
+}
+
+
+// Проверка, что prefix - префикс-функция некоторой строки в алфавите a-z.
+/* Возвращает -1, если это так, и иначе - первый индекс i, на котором prefix[0..i] уже не может быть 
+ * началом префикс-функции. Строка восстанавливается как в prefix_to_string, и одновременно для неё 
+ * считается настоящая префикс-функция; пока они совпадают, переходы по границам можно брать из самого prefix. 
+ * Всё за один линейный проход, который останавливается на первом несоответствии. */
+int validate_prefix_function(const vector <int>& prefix) {
+	const int size = static_cast <int>(prefix.size());
+	if (size == 0)
+		return -1;
+	if (prefix[0] != 0)
+		return 0;
+	// память только резервируется, чтобы ранний отказ не стоил прохода по всему массиву
+	string text(1, start_symbol);
+	text.reserve(size);
+	vector <uint32_t> continuations(1, 1);
+	continuations.reserve(size);
+	for (int i = 1; i < size; i++) {
+		if (prefix[i] < 0 || prefix[i] > prefix[i - 1] + 1)
+			return i;
+		uint32_t border_continuations = continuations[prefix[i - 1]];
+		int symbol;
+		if (prefix[i])
+			symbol = text[prefix[i] - 1] - start_symbol;
+		else {
+			if (border_continuations == (1u << alphabet_size) - 1)
+				return i;
+			symbol = __builtin_ctz(~border_continuations);
+		}
+		text.push_back(static_cast <char>(start_symbol + symbol));
+		continuations.push_back((1u << symbol) | border_continuations);
+		// шаг алгоритма Кнута-Морриса-Пратта по уже проверенным значениям
+		int border = prefix[i - 1];
+		while (border > 0 && text[i] != text[border])
+			border = prefix[border - 1];
+		if (text[i] == text[border])
+			border++;
+		if (border != prefix[i])
+			return i;
+	}
+	return -1;
+}
+
+
+// Проверка, что z - z-функция некоторой строки в алфавите a-z.
+/* Возвращает -1, если это так, и иначе - первый индекс i, на котором z[0..i] уже не может быть 
+ * началом z-функции (z[0], как и в z_to_prefix, не проверяется). Строка строится с опережением: 
+ * как только z[i] расширяет самый правый отрезок до [i, i + z[i]), его новые позиции копируются из начала, 
+ * а свободная позиция получает наименьший символ, не запрещённый условиями z[j] = i - j. 
+ * Каждое условие проверяется в момент, когда оно добавлено: совпадения внутри самого правого отрезка - 
+ * по уже пройденным значениям z, как в validate_prefix_function, а запрет символа в позиции j + z[j] - 
+ * сразу, если позиция уже построена, и при её построении иначе. 
+ * Всё за один линейный проход, который останавливается на первом несоответствии. */
+int validate_z_function(const vector <int>& z) {
+	const int size = static_cast <int>(z.size());
+	if (size == 0)
+		return -1;
+	// память только резервируется, чтобы ранний отказ не стоил прохода по всему массиву
+	string text(1, start_symbol);
+	text.reserve(size);
+	/* Ещё не построенные позиции по возрастанию и маски символов, запрещённых в них условиями z[j] = k - j 
+	 * (символ в позиции k должен отличаться от z[j]-го). */
+	vector <int> restricted;
+	vector <uint32_t> forbidden;
+	size_t next_restricted = 0;
+	// границы самого правого отрезка по уже пройденным значениям z
+	int left_border = 0, right_border = 0;
+	for (int i = 1; i < size; i++) {
+		if (z[i] < 0 || z[i] > size - i)
+			return i;
+		// i-й символ, если его не построил ни один отрезок
+		if (i == static_cast <int>(text.size())) {
+			uint32_t symbols = 0;
+			if (next_restricted < restricted.size() && restricted[next_restricted] == i)
+				symbols = forbidden[next_restricted++];
+			int symbol;
+			if (z[i] > 0) {
+				symbol = text[0] - start_symbol;
+				if (symbols & (1u << symbol))
+					return i;
+			}
+			else {
+				symbols |= 1u << (text[0] - start_symbol);
+				if (symbols == (1u << alphabet_size) - 1)
+					return i;
+				symbol = __builtin_ctz(~symbols);
+			}
+			text.push_back(static_cast <char>(start_symbol + symbol));
+		}
+		
+		// шаг подсчёта z-функции по уже пройденным значениям
+		if (right_border >= i && z[i - left_border] < right_border - i + 1) {
+			if (z[i] != z[i - left_border])
+				return i;
+		}
+		else {
+			if (right_border >= i && z[i] < right_border - i + 1)
+				return i;
+			if (z[i] == 0) {
+				if (text[i] == text[0])
+					return i;
+			}
+			else {
+				// новые позиции отрезка [i, i + z[i]) совпадают с началом строки
+				for (int k = static_cast <int>(text.size()); k < i + z[i]; k++) {
+					if (next_restricted < restricted.size() && restricted[next_restricted] == k) {
+						if (forbidden[next_restricted] & (1u << (text[k - i] - start_symbol)))
+							return i;
+						next_restricted++;
+					}
+					text.push_back(text[k - i]);
+				}
+				if (i + z[i] - 1 > right_border) {
+					left_border = i;
+					right_border = i + z[i] - 1;
+				}
+				// позиция i + z[i] ещё не построена, и в ней запрещён z[i]-й символ
+				if (i + z[i] < size) {
+					if (restricted.empty() || restricted.back() != i + z[i]) {
+						restricted.push_back(i + z[i]);
+						forbidden.push_back(0);
+					}
+					forbidden.back() |= 1u << (text[z[i]] - start_symbol);
+					if (forbidden.back() == (1u << alphabet_size) - 1)
+						return i;
+				}
+			}
+		}
+	}
+	return -1;
 }
 
 
@@ -1,7 +1,14 @@
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "suffix array.h"
+
 using namespace std;
 
 /* Специальный символ, не встречающийся в данной строке
@@ -10,120 +17,425 @@ using namespace std;
  * строке из произвольных печатных символов - т.е. символов с кодами от 32 до 126. */
 const char special_symbol = 31;
 const int alphabet_size = 96;
+const Alphabet alphabet = {special_symbol, alphabet_size};
 
-/* Модифицирует массив, получившийся после подсчёта, так, чтобы count[i] 
- * хранил позицию, в которую нужно начинать ставить элементы с ключом i.
- * Изначально count[i] - количество элементов с ключом i. */
-void count_positions(vector <int>& count) {
-	if (count.empty())
-		return;
-	int last = count[0];
-	count[0] = 0;
-	for (int i = 1; i < static_cast <int>(count.size()); i++) {
-		int temp = count[i];
-		count[i] = last;
-		last += temp;
+/* Суффиксный автомат, строящийся по мере добавления символов (алгоритм Блумера и др.).
+ * После каждого append известно число различных подстрок уже добавленной строки:
+ * новое состояние last добавляет length[last] - length[link[last]] подстрок, клоны числа не меняют.
+ * Рёбра лежат в общем массиве и связаны в список у каждого состояния. Как и в боре Ахо-Корасик, 
+ * состояние, у которого рёбер больше dense_threshold, получает полную таблицу переходов: 
+ * таких состояний немного (это короткие частые подстроки), а через них проходит большинство поисков. 
+ * Состояний не больше 2n, рёбер не больше 3n, так что append работает за амортизированное O(1). */
+class SuffixAutomaton {
+	static const int dense_threshold = 8;
+	
+	struct State {
+		int length, link, first_edge, degree;
+		// начало таблицы переходов в dense или -1
+		int dense;
+	};
+	struct Edge {
+		int target, next;
+		char symbol;
+	};
+	
+	vector <State> states;
+	vector <Edge> edges;
+	// таблицы переходов по alphabet_size номеров рёбер (-1 - нет ребра), символ c - на месте c - special_symbol
+	vector <int> dense;
+	int last;
+	long long distinct;
+	
+	// номер ребра из state по символу symbol или -1, если его нет
+	int find(int state, char symbol) const {
+		if (states[state].dense != -1)
+			return dense[states[state].dense + (symbol - special_symbol)];
+		for (int edge = states[state].first_edge; edge != -1; edge = edges[edge].next)
+			if (edges[edge].symbol == symbol)
+				return edge;
+		return -1;
 	}
-}
-
-// Построение суффиксного массива suf (изначально заполнен нулями) по строке s.
-void build_suffix_array(const string& s, vector <int>& suf) {
-	const int size = static_cast <int>(s.length());
-	// вспомогательный массив для сортировки подсчётом
-	vector <int> count(alphabet_size, 0);
-	// классы эквивалентности суффиксов по первым символам
-	vector <int> classes(size, 0);
-	for (int i = 0; i < size; i++)
-		count[s[i] - special_symbol]++;
-	count_positions(count);
-	for (int i = 0; i < size; i++)
-		suf[count[s[i] - special_symbol]++] = i;
-	char current_char = special_symbol;
-	int current_class = 0;
-	// определяем классы эквивалентности для первого этапа сортировки
-	for (int i = 0; i < size; i++) {
-		if (s[suf[i]] != current_char) {
-			current_char = s[suf[i]];
-			current_class++;
-		}
-		classes[suf[i]] = current_class;
-	}
-	
-	int current_length = 1;
-	// сортируем по первым current_length символам
-	while (current_length < size) {
-		// сортировка по 2 половине
-		vector <int> sufs_by_2nd_half(size, 0);
-		for (int i = 0; i < size; i++) {
-			sufs_by_2nd_half[i] = (suf[i] - current_length + size) % size;
-		}
-	
-		// сортировка по 1 половине
-		count.assign(size, 0);
-		for (int i = 0; i < size; i++)
-			count[classes[sufs_by_2nd_half[i]]]++;
-		count_positions(count);
-		for (int i = 0; i < size; i++)
-			suf[count[classes[sufs_by_2nd_half[i]]]++] = sufs_by_2nd_half[i];
-			
-		// определение новых классов эквивалентности
-		vector <int> new_classes(size, 0);
-		current_class = 0;
-		for (int i = 0; i < size; i++) {
-			new_classes[suf[i]] = current_class;
-			if (i < size - 1 && (classes[suf[i]] != classes[suf[i + 1]] || 
-				classes[(suf[i] + current_length) % size] != classes[(suf[i + 1] + current_length) % size]))
-				current_class++;
-		}
-		classes = new_classes;
-		current_length *= 2;
+	
+	void add_edge(int state, char symbol, int target) {
+		edges.push_back({target, states[state].first_edge, symbol});
+		int edge = static_cast <int>(edges.size()) - 1;
+		State& current = states[state];
+		current.first_edge = edge;
+		current.degree++;
+		if (current.dense != -1) {
+			dense[current.dense + (symbol - special_symbol)] = edge;
+		}
+		else if (current.degree > dense_threshold) {
+			current.dense = static_cast <int>(dense.size());
+			dense.resize(dense.size() + alphabet_size, -1);
+			for (int i = edge; i != -1; i = edges[i].next)
+				dense[current.dense + (edges[i].symbol - special_symbol)] = i;
+		}
 	}
-}
-
-// Построение массива lcp алгоритмом Касаи и др., за линейное время.
-// В данной реализации lcp[i] - длина наибольшего общего префикса suf[i] и suf[i - 1]-го суффиксов.
-void build_lcp (const string& s, const vector <int>& suf, vector <int>& lcp) {
-	const int size = static_cast <int>(s.length());
-	vector <int> positions(size, 0);
-	for (int i = 0; i < size; i++)
-		positions[suf[i]] = i;
-	int current_lcp = 0;
-	for (int i = 0; i < size; i++) {
-		if (current_lcp > 0)
-			current_lcp--;
-		if (positions[i] > 0) {
-			/* k - порядковый номер суффикса, стоящего перед i-м суффиксом в суффиксном массиве.
-			 * Здесь k-й суффикс - это s_k...s_{n-1}, i-й суффикс - s_i...s{n-1},
-			 * и один стоит прямо перед другим в суффиксном массиве. */
-			int k = suf[positions[i] - 1];
-			while (i + current_lcp < size && k + current_lcp < size && 
-				   s[i + current_lcp] == s[k + current_lcp])
-				current_lcp++;
-			lcp[positions[i]] = current_lcp;
-		}
-		else {
-			current_lcp = 0;
-			lcp[0] = -1;
+	
+public:
+	SuffixAutomaton(): states(1, State{0, -1, -1, 0, -1}), last(0), distinct(0) {}
+	
+	// Резервирует память под строку длины length, чтобы обойтись без перевыделений.
+	void reserve(int length) {
+		states.reserve(2 * static_cast <size_t>(length) + 1);
+		edges.reserve(3 * static_cast <size_t>(length));
+	}
+	
+	// Добавляет символ в конец строки и возвращает число её различных подстрок.
+	long long append(char symbol) {
+		int current = static_cast <int>(states.size());
+		states.push_back({states[last].length + 1, 0, -1, 0, -1});
+		int state = last;
+		while (state != -1 && find(state, symbol) == -1) {
+			add_edge(state, symbol, current);
+			state = states[state].link;
 		}
+		if (state != -1) {
+			int next = edges[find(state, symbol)].target;
+			if (states[state].length + 1 == states[next].length) {
+				states[current].link = next;
+			}
+			else {
+				int clone = static_cast <int>(states.size());
+				states.push_back({states[state].length + 1, states[next].link, -1, 0, -1});
+				for (int edge = states[next].first_edge; edge != -1; edge = edges[edge].next)
+					add_edge(clone, edges[edge].symbol, edges[edge].target);
+				while (state != -1) {
+					int edge = find(state, symbol);
+					if (edges[edge].target != next)
+						break;
+					edges[edge].target = clone;
+					state = states[state].link;
+				}
+				states[next].link = clone;
+				states[current].link = clone;
+			}
+		}
+		last = current;
+		distinct += states[current].length - states[states[current].link].length;
+		return distinct;
 	}
-}
+	
+	long long distinct_substrings() const {
+		return distinct;
+	}
+	
+	int size() const {
+		return static_cast <int>(states.size());
+	}
+	
+	int edge_count() const {
+		return static_cast <int>(edges.size());
+	}
+	
+	// Память под состояния, рёбра и полные таблицы; в расчёте на состояние - memory_usage() / size().
+	size_t memory_usage() const {
+		return states.capacity() * sizeof(State) + edges.capacity() * sizeof(Edge) + dense.capacity() * sizeof(int);
+	}
+};
 
-// Функция для решения задачи.
-long long count_substrings(string& str) {
-	str += special_symbol;
-	long long size = static_cast <long long>(str.length());
-	vector <int> suf(str.length(), 0), lcp(str.length(), 0);
-	build_suffix_array(str, suf);
-	build_lcp(str, suf, lcp);
+/* FM-индекс: сжатое представление суффиксного массива, отвечающее на запросы о вхождениях образца.
+ * Хранит BWT строки (bwt[i] - символ перед suf[i]-м суффиксом) в вейвлет-дереве формы кода Хаффмана - 
+ * не больше H0 + 1 бит на символ, т.е. 1 бит для двоичных строк и 2 для ДНК, - и каждый sample_rate-й 
+ * по позиции в строке элемент суффиксного массива. Специальный символ встречается в BWT один раз, 
+ * поэтому в дерево вместо него записывается самый частый символ, а rank поправляется на месте special_row. count - обратный поиск за O(|pattern| * H0), 
+ * locate - ещё до sample_rate шагов LF на каждое вхождение. Суффиксный массив нужен только при построении. */
+class FmIndex {
+	// Битовый вектор с подсчётом единиц на префиксе за O(1): blocks[k] - число единиц в первых 512k битах.
+	class BitVector {
+		vector <uint64_t> words;
+		vector <uint32_t> blocks;
+		
+	public:
+		// Биты задаются словами по 64 (младший бит слова - первый); слов должно быть не меньше size / 64 + 1.
+		void assign(vector <uint64_t> bits) {
+			words = move(bits);
+			blocks.assign(words.size() / 8 + 1, 0);
+			uint32_t ones = 0;
+			for (size_t i = 0; i < words.size(); i++) {
+				if (i % 8 == 0)
+					blocks[i / 8] = ones;
+				ones += __builtin_popcountll(words[i]);
+			}
+		}
+		
+		bool operator[](int i) const {
+			return (words[i >> 6] >> (i & 63)) & 1;
+		}
+		
+		// число единиц среди первых i битов
+		int rank(int i) const {
+			int result = blocks[i >> 9];
+			for (int word = (i >> 9) << 3; word < (i >> 6); word++)
+				result += __builtin_popcountll(words[word]);
+			return result + __builtin_popcountll(words[i >> 6] & ((uint64_t(1) << (i & 63)) - 1));
+		}
+		
+		size_t memory_usage() const {
+			return words.capacity() * sizeof(uint64_t) + blocks.capacity() * sizeof(uint32_t);
+		}
+	};
+	
+	// Внутренняя вершина вейвлет-дерева: child[b] - номер вершины или -1 - код, если это лист.
+	struct Node {
+		int child[2];
+		BitVector bits;
+	};
+	
+	int text_size, sample_rate, root;
+	// место специального символа в BWT и код, записанный вместо него
+	int special_row, special_replacement;
+	vector <Node> nodes;
+	// путь от корня до листа кода c: code[c] (k-й бит - направление на глубине k) и его длина
+	vector <uint64_t> code;
+	vector <int> code_length;
+	// less[c] - количество символов строки с кодом меньше c
+	vector <int> less;
+	// sampled[i] - сохранён ли suf[i], samples - сохранённые значения по порядку
+	BitVector sampled;
+	vector <int> samples;
 	
+	static vector <uint64_t> empty_words(int size) {
+		return vector <uint64_t>(size / 64 + 1, 0);
+	}
+	
+	// Строит поддерево вершины node по подпоследовательности sequence кодов BWT, попавших в неё.
+	void build_node(int node, vector <uint8_t>& sequence, int depth) {
+		vector <uint64_t> bits = empty_words(static_cast <int>(sequence.size()));
+		vector <uint8_t> parts[2];
+		for (size_t i = 0; i < sequence.size(); i++) {
+			int bit = (code[sequence[i]] >> depth) & 1;
+			bits[i >> 6] |= static_cast <uint64_t>(bit) << (i & 63);
+			parts[bit].push_back(sequence[i]);
+		}
+		vector <uint8_t>().swap(sequence);
+		nodes[node].bits.assign(move(bits));
+		for (int bit = 0; bit < 2; bit++)
+			if (nodes[node].child[bit] >= 0)
+				build_node(nodes[node].child[bit], parts[bit], depth + 1);
+	}
+	
+	// количество символов с кодом symbol среди первых i символов BWT
+	int rank(int symbol, int i) const {
+		int node = root;
+		int position = i;
+		for (int depth = 0; depth < code_length[symbol]; depth++) {
+			int bit = (code[symbol] >> depth) & 1;
+			int ones = nodes[node].bits.rank(position);
+			position = bit ? ones : position - ones;
+			node = nodes[node].child[bit];
+		}
+		return symbol == special_replacement && i > special_row ? position - 1 : position;
+	}
+	
+	/* LF(i) - место в суффиксном массиве суффикса, который на один символ длиннее suf[i]-го. 
+	 * Для special_row не вызывается: там нулевой суффикс, а он всегда сохранён. */
+	int last_to_first(int i) const {
+		int node = root;
+		int position = i;
+		while (true) {
+			int bit = nodes[node].bits[position];
+			int ones = nodes[node].bits.rank(position);
+			position = bit ? ones : position - ones;
+			if (nodes[node].child[bit] < 0) {
+				int symbol = -nodes[node].child[bit] - 1;
+				return less[symbol] + (symbol == special_replacement && i > special_row ? position - 1 : position);
+			}
+			node = nodes[node].child[bit];
+		}
+	}
+	
+	/* Отрезок [left, right) суффиксного массива, суффиксы в котором начинаются с pattern. 
+	 * Пустому образцу соответствуют все суффиксы, кроме нулевого - одного специального символа. */
+	pair <int, int> find_range(const string& pattern) const {
+		if (pattern.empty())
+			return {min(1, text_size), text_size};
+		int left = 0, right = text_size;
+		for (int i = static_cast <int>(pattern.length()) - 1; i >= 0 && left < right; i--) {
+			int symbol = pattern[i] - special_symbol;
+			if (symbol <= 0 || symbol >= alphabet_size || code_length[symbol] == 0)
+				return {0, 0};
+			left = less[symbol] + rank(symbol, left);
+			right = less[symbol] + rank(symbol, right);
+		}
+		return {left, right};
+	}
+	
+public:
+	FmIndex(): text_size(0), sample_rate(1), root(0), special_row(0), special_replacement(0) {}
+	
+	// Построение по строке s, которая оканчивается специальным символом.
+	void build(const string& s, int rate = 32) {
+		text_size = static_cast <int>(s.length());
+		sample_rate = rate;
+		vector <uint8_t> bwt(text_size);
+		vector <uint64_t> sampled_bits = empty_words(text_size);
+		samples.clear();
+		samples.reserve(text_size / sample_rate + 1);
+		{
+			vector <int> suf(text_size, 0);
+			build_suffix_array(s, suf, alphabet);
+			for (int i = 0; i < text_size; i++) {
+				bwt[i] = static_cast <uint8_t>((suf[i] > 0 ? s[suf[i] - 1] : s[text_size - 1]) - special_symbol);
+				if (suf[i] % sample_rate == 0) {
+					sampled_bits[i >> 6] |= uint64_t(1) << (i & 63);
+					samples.push_back(suf[i]);
+				}
+			}
+		}
+		sampled.assign(move(sampled_bits));
+		
+		vector <long long> frequency(alphabet_size, 0);
+		for (uint8_t symbol : bwt)
+			frequency[symbol]++;
+		less.assign(alphabet_size + 1, 0);
+		for (int c = 0; c < alphabet_size; c++)
+			less[c + 1] = less[c] + static_cast <int>(frequency[c]);
+		special_row = static_cast <int>(find(bwt.begin(), bwt.end(), 0) - bwt.begin());
+		special_replacement = static_cast <int>(max_element(frequency.begin() + 1, frequency.end()) - frequency.begin());
+		if (special_row < text_size) {
+			bwt[special_row] = static_cast <uint8_t>(special_replacement);
+			frequency[special_replacement]++;
+			frequency[0]--;
+		}
+		
+		/* Дерево Хаффмана по частотам: листья - коды символов, записанные как -(код + 1).
+		 * Нужны хотя бы два листа, поэтому при единственном символе добавляется пустой. */
+		priority_queue <pair <long long, int>, vector <pair <long long, int>>, greater <pair <long long, int>>> queue;
+		for (int c = 0; c < alphabet_size; c++)
+			if (frequency[c] > 0)
+				queue.push({frequency[c], -(c + 1)});
+		if (queue.size() == 1)
+			queue.push({0, -((-queue.top().second) % alphabet_size + 1)});
+		nodes.clear();
+		while (queue.size() > 1) {
+			pair <long long, int> first = queue.top();
+			queue.pop();
+			pair <long long, int> second = queue.top();
+			queue.pop();
+			nodes.push_back({{first.second, second.second}, BitVector()});
+			queue.push({first.first + second.first, static_cast <int>(nodes.size()) - 1});
+		}
+		root = queue.top().second;
+		
+		code.assign(alphabet_size, 0);
+		code_length.assign(alphabet_size, 0);
+		vector <pair <int, pair <uint64_t, int>>> stack = {{root, {0, 0}}};
+		while (!stack.empty()) {
+			int node = stack.back().first;
+			uint64_t path = stack.back().second.first;
+			int depth = stack.back().second.second;
+			stack.pop_back();
+			for (int bit = 0; bit < 2; bit++) {
+				int child = nodes[node].child[bit];
+				uint64_t child_path = path | (static_cast <uint64_t>(bit) << depth);
+				if (child < 0) {
+					code[-child - 1] = child_path;
+					code_length[-child - 1] = depth + 1;
+				}
+				else {
+					stack.push_back({child, {child_path, depth + 1}});
+				}
+			}
+		}
+		build_node(root, bwt, 0);
+	}
+	
+	// количество вхождений pattern в строку
+	int count(const string& pattern) const {
+		pair <int, int> range = find_range(pattern);
+		return range.second - range.first;
+	}
+	
+	// позиции всех вхождений pattern в строку по возрастанию
+	vector <int> locate(const string& pattern) const {
+		pair <int, int> range = find_range(pattern);
+		vector <int> result;
+		for (int i = range.first; i < range.second; i++) {
+			int position = i, steps = 0;
+			while (!sampled[position]) {
+				position = last_to_first(position);
+				steps++;
+			}
+			result.push_back(samples[sampled.rank(position)] + steps);
+		}
+		sort(result.begin(), result.end());
+		return result;
+	}
+	
+	int size() const {
+		return text_size;
+	}
+	
+	size_t memory_usage() const {
+		size_t result = sampled.memory_usage() + samples.capacity() * sizeof(int) + 
+		                less.capacity() * sizeof(int) + code.capacity() * sizeof(uint64_t) + code_length.capacity() * sizeof(int);
+		for (const Node& node : nodes)
+			result += sizeof(Node) + node.bits.memory_usage();
+		return result;
+	}
+};
+
+// Количество различных подстрок строки, по которой построен индекс.
+long long count_substrings(const SuffixIndex& index) {
+	long long size = static_cast <long long>(index.size());
 	long long summary_lcp = 0;
 	for (int i = 1; i < size; i++) {
-		summary_lcp += lcp[i];
+		summary_lcp += index.lcp(i);
 	}
 	
 	return (size * (size - 1)) / 2 - summary_lcp;
 }
 
+// Функция для решения задачи.
+// Если threads > 1, суффиксный массив и lcp строятся в threads потоков.
+long long count_substrings(string& str, int threads = 1) {
+	str += special_symbol;
+	SuffixIndex index;
+	index.build(str, alphabet, threads);
+	return count_substrings(index);
+}
+
+
+// Десятичная запись 128-битного числа.
+string to_decimal(unsigned __int128 value) {
+	string result;
+	do {
+		result += static_cast <char>('0' + static_cast <int>(value % 10));
+		value /= 10;
+	} while (value > 0);
+	reverse(result.begin(), result.end());
+	return result;
+}
+
+/* Количество различных подстрок строки из файла filename с построением во внешней памяти 
+ * (см. build_suffix_array_external): n(n - 1) / 2 минус сумма lcp. Уже для строк длиннее 6 * 10^9 
+ * ответ не помещается в 64 бита. Файл читается только подряд и может не помещаться в память.
+ * Возвращает false, если файл не открылся или не хватило места на диске. */
+bool count_substrings_external(const string& filename, unsigned __int128& result, 
+                               size_t memory_limit = size_t(1) << 30, const string& directory = "/tmp") {
+	ExternalText text;
+	if (!text.add(filename, special_symbol))
+		return false;
+	try {
+		unique_ptr <TemporaryFile> suf = build_suffix_array_external(text, alphabet, memory_limit, directory);
+		unique_ptr <TemporaryFile> lcp = build_lcp_external(text, *suf, memory_limit, directory);
+		suf.reset();
+		unsigned __int128 size = static_cast <uint64_t>(text.size());
+		unsigned __int128 summary_lcp = 0;
+		RecordReader <int64_t> reader(*lcp);
+		int64_t value = 0;
+		while (reader.next(value))
+			if (value > 0)
+				summary_lcp += value;
+		result = size * (size - 1) / 2 - summary_lcp;
+	}
+	catch (const runtime_error&) {
+		return false;
+	}
+	return true;
+}
 
 void solve() {
 	string str;
@@ -6,12 +6,32 @@
  * Формат вывода:
    Позиции вхождения шаблона в строке.*/
  
-#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <iostream>
 #include <string>
 #include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 using namespace std;
 
+/* Если true, пробельные символы текста пропускаются (как при чтении через >>).
+ * Если false, они считаются обычными символами текста; от шаблона тогда отделяется ровно один перевод строки. */
+const bool skip_whitespace = true;
+
+/* Шаблоны не длиннее этого ищутся по полной таблице переходов КМП-автомата 
+ * размером (длина шаблона + 1) x symbols, т.е. до ~1 Мб. */
+const int automaton_max_length = 1024;
+const int symbols = 256;
+
 
 // Считает префикс-функцию prefix строки sample.
 void prefix_function(const string& sample, vector <int>& prefix) {
@@ -33,46 +53,322 @@ void prefix_function(const string& sample, vector <int>& prefix) {
 }
 
 
-// Реализует алгоритм Кнута-Морриса-Пратта. Принимает на вход потоки ввода и вывода, 
-// шаблон и текст считываются и обрабатываются в процессе работы.
-void find_pattern_in_stream(ifstream& fin, ofstream& fout, const string& pattern) {
-	vector <int> prefix; // хранит префикс-функцию шаблона
-	prefix_function(pattern, prefix);
-	char last;  // последний введённый символ
-	// Префикс-функция предпоследнего и последнего элементов и их счётчик.
-	int previous_prefix = 0, last_prefix = 0, counter = 0;
-	while (fin >> last) {
-		// Подсчитываем префикс-функцию для текущего рассматриваемого элемента.
-		if (last == pattern[previous_prefix])
-			last_prefix = previous_prefix + 1;
-		else {
-			int current = previous_prefix - 1;
-			while (current >= 0 && last != pattern[prefix[current]])
-					current = prefix[current] - 1;
-			if (current >= 0 && last == pattern[prefix[current]]) {
-				last_prefix = prefix[current] + 1; 
+/* Ищет первое вхождение символа symbol в data[from], ..., data[to - 1]; если его нет, возвращает to.
+ * Сравнивает по 32 (AVX2) или 16 (SSE2) символов за раз, хвост досматривается по одному. */
+size_t find_symbol(const char* data, size_t from, size_t to, char symbol) {
+	size_t i = from;
+#if defined(__AVX2__)
+	const __m256i needle = _mm256_set1_epi8(symbol);
+	for (; i + 32 <= to; i += 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast <const __m256i*>(data + i));
+		unsigned mask = static_cast <unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+#if defined(__SSE2__)
+	const __m128i needle_16 = _mm_set1_epi8(symbol);
+	for (; i + 16 <= to; i += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast <const __m128i*>(data + i));
+		unsigned mask = static_cast <unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle_16)));
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i < to; i++) {
+		if (data[i] == symbol)
+			return i;
+	}
+	return to;
+}
+
+
+// Входной файл. Читается целиком через mmap, а если это невозможно (например, это канал) - блоками через read().
+class InputStream {
+	int fd;
+	// отображённый в память файл
+	const char* mapped;
+	size_t mapped_size;
+	// буфер для чтения через read()
+	vector <char> buffer;
+	// ещё не прочитанная часть отображённого файла или буфера
+	const char* current;
+	const char* limit;
+	
+	// Гарантирует, что есть хотя бы один непрочитанный символ. Возвращает false в конце файла.
+	bool fill() {
+		if (current < limit)
+			return true;
+		if (mapped != nullptr || fd < 0)
+			return false;
+		ssize_t received = read(fd, buffer.data(), buffer.size());
+		if (received <= 0)
+			return false;
+		current = buffer.data();
+		limit = current + received;
+		return true;
+	}
+	
+public:
+	// размер кусков, которые отдаёт next_block
+	static constexpr size_t block_size = 1 << 20;
+	
+	explicit InputStream(const string& filename): fd(open(filename.c_str(), O_RDONLY)), mapped(nullptr), 
+	                                              mapped_size(0), current(nullptr), limit(nullptr) {
+		struct stat file_stat;
+		if (fd >= 0 && fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0) {
+			void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED) {
+				madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+				mapped = static_cast <const char*>(data);
+				mapped_size = static_cast <size_t>(file_stat.st_size);
+				current = mapped;
+				limit = mapped + mapped_size;
 			}
-			else {
-				last_prefix = 0;
+		}
+		if (mapped == nullptr)
+			buffer.resize(block_size);
+	}
+	
+	~InputStream() {
+		if (mapped != nullptr)
+			munmap(const_cast <char*>(mapped), mapped_size);
+		if (fd >= 0)
+			close(fd);
+	}
+	
+	// Пропускает пробельные символы и читает слово (как fin >> word).
+	string read_word() {
+		string word;
+		while (fill() && isspace(static_cast <unsigned char>(*current)))
+			current++;
+		while (fill() && !isspace(static_cast <unsigned char>(*current)))
+			word.push_back(*current++);
+		return word;
+	}
+	
+	// Пропускает один перевод строки ("\n" или "\r\n"), если он идёт следующим.
+	void skip_line_break() {
+		if (fill() && *current == '\r')
+			current++;
+		if (fill() && *current == '\n')
+			current++;
+	}
+	
+	/* Отдаёт очередной кусок файла длиной не больше block_size: data - его начало, size - длина.
+	 * Данные остаются действительными до следующего вызова. Возвращает false в конце файла. */
+	bool next_block(const char*& data, size_t& size) {
+		if (!fill())
+			return false;
+		data = current;
+		size = min(static_cast <size_t>(limit - current), block_size);
+		current += size;
+		return true;
+	}
+	
+	InputStream(const InputStream&) = delete;
+	InputStream& operator=(const InputStream&) = delete;
+};
+
+
+// Выходной файл. Числа форматируются в буфер, который сбрасывается на диск большими кусками.
+class OutputBuffer {
+	int fd;
+	vector <char> buffer;
+	size_t used;
+	
+public:
+	explicit OutputBuffer(const string& filename): fd(open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)), 
+	                                               buffer(1 << 20), used(0) {}
+	
+	~OutputBuffer() {
+		flush();
+		if (fd >= 0)
+			close(fd);
+	}
+	
+	// Записывает число number и пробел после него.
+	void write_number(long long number) {
+		// 20 символов на число и 1 на пробел
+		if (used + 21 > buffer.size())
+			flush();
+		used = to_chars(buffer.data() + used, buffer.data() + buffer.size(), number).ptr - buffer.data();
+		buffer[used++] = ' ';
+	}
+	
+	void flush() {
+		size_t written = 0;
+		while (fd >= 0 && written < used) {
+			ssize_t result = write(fd, buffer.data() + written, used - written);
+			if (result <= 0)
+				break;
+			written += static_cast <size_t>(result);
+		}
+		used = 0;
+	}
+	
+	OutputBuffer(const OutputBuffer&) = delete;
+	OutputBuffer& operator=(const OutputBuffer&) = delete;
+};
+
+
+// Скомпилированный шаблон: префикс-функция и, для коротких шаблонов, полная таблица переходов КМП-автомата.
+class KmpPattern {
+	string pattern;
+	vector <int> prefix;
+	/* automaton[state * symbols + c] - состояние после символа c из состояния state, 0 <= state <= длина шаблона.
+	 * Строится, только если длина шаблона не больше automaton_max_length. */
+	vector <int> automaton;
+	
+public:
+	explicit KmpPattern(const string& pattern_): pattern(pattern_) {
+		prefix_function(pattern, prefix);
+		const int pattern_length = length();
+		if (pattern_length > automaton_max_length)
+			return;
+		automaton.assign((pattern_length + 1) * symbols, 0);
+		for (int state = 0; state <= pattern_length; state++) {
+			// переходы, которые не продолжают совпадение, - такие же, как из состояния по префикс-функции
+			if (state > 0)
+				copy_n(automaton.begin() + prefix[state - 1] * symbols, symbols, automaton.begin() + state * symbols);
+			if (state < pattern_length)
+				automaton[state * symbols + static_cast <unsigned char>(pattern[state])] = state + 1;
+		}
+	}
+	
+	int length() const {
+		return static_cast <int>(pattern.length());
+	}
+	
+	char first_symbol() const {
+		return pattern[0];
+	}
+	
+	bool has_automaton() const {
+		return !automaton.empty();
+	}
+	
+	// Переход по символу last из состояния state по таблице (только если has_automaton()).
+	int table_step(int state, char last) const {
+		return automaton[state * symbols + static_cast <unsigned char>(last)];
+	}
+	
+	// Переход по символу last из состояния state (значения префикс-функции) с помощью префикс-функции шаблона.
+	int prefix_step(int state, char last) const {
+		if (state < length() && last == pattern[state])
+			return state + 1;
+		int current = state - 1;
+		while (current >= 0 && last != pattern[prefix[current]])
+				current = prefix[current] - 1;
+		if (current >= 0 && last == pattern[prefix[current]])
+			return prefix[current] + 1; 
+		return 0;
+	}
+};
+
+
+/* Поиск шаблона в потоке, который поступает произвольными кусками через feed.
+ * Хранит только состояние КМП-автомата и число уже обработанных символов, 
+ * так что один поток может обслуживать сколько угодно таких поисков. 
+ * Сам шаблон не копируется и должен жить дольше матчера. */
+class StreamMatcher {
+	const KmpPattern* pattern;
+	bool skip_whitespace;
+	// префикс-функция последнего обработанного символа
+	int state;
+	// сколько символов потока уже обработано
+	long long offset;
+	
+	// Обработка куска без пробельных символов; step задаёт переход автомата.
+	template <class Step, class Callback>
+	void scan(const char* data, size_t size, Step step, Callback& report) {
+		const int pattern_length = pattern->length();
+		size_t i = 0;
+		while (i < size) {
+			/* Из нулевого состояния выводит только первый символ шаблона, 
+			 * поэтому до следующего такого символа можно сразу пропустить весь кусок. */
+			if (state == 0) {
+				i = find_symbol(data, i, size, pattern->first_symbol());
+				if (i == size)
+					break;
 			}
+			state = step(state, data[i]);
+			if (state == pattern_length)
+				report(offset + static_cast <long long>(i) - pattern_length + 1);
+			i++;
+		}
+		offset += static_cast <long long>(size);
+	}
+	
+	template <class Callback>
+	void scan(const char* data, size_t size, Callback& report) {
+		if (pattern->has_automaton())
+			scan(data, size, [this](int current, char last) { return pattern->table_step(current, last); }, report);
+		else
+			scan(data, size, [this](int current, char last) { return pattern->prefix_step(current, last); }, report);
+	}
+	
+public:
+	// Если skip_whitespace_, пробельные символы пропускаются, и позиции считаются только по остальным символам.
+	StreamMatcher(const KmpPattern& pattern_, bool skip_whitespace_): pattern(&pattern_), 
+	                                                                  skip_whitespace(skip_whitespace_), 
+	                                                                  state(0), offset(0) {}
+	
+	/* Обработка очередного куска потока. Для каждого вхождения шаблона, закончившегося в этом куске, 
+	 * вызывает report(позиция начала вхождения от начала потока). */
+	template <class Callback>
+	void feed(const char* data, size_t size, Callback report) {
+		if (!skip_whitespace) {
+			scan(data, size, report);
+			return;
+		}
+		// пробельные символы выкидываются небольшими порциями через буфер на стеке
+		const size_t portion = 1 << 12;
+		char compacted[portion];
+		for (size_t begin = 0; begin < size; begin += portion) {
+			size_t end = min(size, begin + portion);
+			char* compacted_end = remove_copy_if(data + begin, data + end, compacted, 
+			                                     [](char c) { return isspace(static_cast <unsigned char>(c)); });
+			scan(compacted, static_cast <size_t>(compacted_end - compacted), report);
 		}
-		if (last_prefix == static_cast<int>(pattern.length()))
-			fout << counter - static_cast<int>(pattern.length()) + 1 << " ";
-		counter++;
-		previous_prefix = last_prefix;
 	}
+	
+	// Сколько символов потока уже обработано (без пропущенных пробельных).
+	long long position() const {
+		return offset;
+	}
+	
+	// Начать новый поток с начала.
+	void reset() {
+		state = 0;
+		offset = 0;
+	}
+};
+
+
+// Реализует алгоритм Кнута-Морриса-Пратта. Принимает на вход потоки ввода и вывода, 
+// шаблон и текст считываются и обрабатываются в процессе работы.
+// Если skip_whitespace, пробельные символы текста пропускаются, и позиции считаются только по остальным символам.
+// Для шаблонов не длиннее automaton_max_length каждый символ обрабатывается одним обращением к таблице переходов,
+// для более длинных - переходами по префикс-функции (амортизированно O(1)).
+void find_pattern_in_stream(InputStream& fin, OutputBuffer& fout, const string& pattern, bool skip_whitespace) {
+	KmpPattern compiled(pattern);
+	StreamMatcher matcher(compiled, skip_whitespace);
+	const char* data;
+	size_t size;
+	while (fin.next_block(data, size))
+		matcher.feed(data, size, [&](long long position) { fout.write_number(position); });
 }
 
 
 // Функция для решения.
 void solve() {
-	ifstream fin("input.txt");
-	ofstream fout("output.txt");
-	string pattern;
-	fin >> pattern;
-	find_pattern_in_stream(fin, fout, pattern);
-	fin.close();
-	fout.close();
+	InputStream fin("input.txt");
+	OutputBuffer fout("output.txt");
+	string pattern = fin.read_word();
+	if (!skip_whitespace)
+		fin.skip_line_break();
+	find_pattern_in_stream(fin, fout, pattern, skip_whitespace);
 }
 
                                                                                                                           
@@ -0,0 +1,1268 @@
+/* Суффиксный массив и всё, что строится вокруг него: SA-IS и параллельное удвоение, lcp, 
+ * суффиксный индекс с сохранением в файл, минимумы на отрезках для lcp любых двух суффиксов 
+ * и построение во внешней памяти. Общий код для "number of substrings.cpp" и "k-th common substring.cpp": 
+ * строки в них оканчиваются разными специальными символами, поэтому алфавит передаётся явно (см. Alphabet). */
+#ifndef SUFFIX_ARRAY_H
+#define SUFFIX_ARRAY_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/* Алфавит строки: символы sentinel, sentinel + 1, ..., sentinel + size - 1.
+ * sentinel - наименьший из них, он не встречается в самой строке и добавляется в её конец 
+ * для построения суффиксного массива (в SA-IS он получает номер 0). */
+struct Alphabet {
+	char sentinel;
+	int size;
+};
+
+/* Параллельное удвоение в одном потоке примерно в 2.5 раза медленнее SA-IS, а его ускорение на нескольких 
+ * ядрах не измерено, поэтому по умолчанию индекс строится SA-IS, а потоки используются, только если их число 
+ * передано явно. Каждому потоку достаётся не меньше parallel_min_chunk позиций: на меньших кусках 
+ * запуск потоков на каждом шаге удвоения обходится дороже самой работы. */
+const int parallel_min_chunk = 1 << 16;
+
+/* Корзины для SA-IS: bucket[c] - начало (end == false) или конец (end == true) 
+ * отрезка суффиксного массива, который занимают суффиксы, начинающиеся с символа c. */
+template <class Symbols>
+void get_buckets(const Symbols& symbol, int size, int alphabet, vector <int>& bucket, bool end) {
+	bucket.assign(alphabet, 0);
+	for (int i = 0; i < size; i++)
+		bucket[symbol(i)]++;
+	int sum = 0;
+	for (int c = 0; c < alphabet; c++) {
+		sum += bucket[c];
+		bucket[c] = (end ? sum : sum - bucket[c]);
+	}
+}
+
+// Индуцированная сортировка L-суффиксов (меньших следующего) по уже расставленным в suf суффиксам.
+template <class Symbols>
+void induce_l_suffixes(const Symbols& symbol, const vector <bool>& s_type, int* suf, int size, int alphabet, 
+                       vector <int>& bucket) {
+	get_buckets(symbol, size, alphabet, bucket, false);
+	for (int i = 0; i < size; i++) {
+		int j = suf[i] - 1;
+		if (j >= 0 && !s_type[j])
+			suf[bucket[symbol(j)]++] = j;
+	}
+}
+
+// Индуцированная сортировка S-суффиксов (больших следующего) по уже расставленным в suf суффиксам.
+template <class Symbols>
+void induce_s_suffixes(const Symbols& symbol, const vector <bool>& s_type, int* suf, int size, int alphabet, 
+                       vector <int>& bucket) {
+	get_buckets(symbol, size, alphabet, bucket, true);
+	for (int i = size - 1; i >= 0; i--) {
+		int j = suf[i] - 1;
+		if (j >= 0 && s_type[j])
+			suf[--bucket[symbol(j)]] = j;
+	}
+}
+
+// Символы сокращённой строки в SA-IS - числа, записанные в хвосте суффиксного массива.
+struct ReducedSymbols {
+	const int* data;
+	int operator()(int i) const {
+		return data[i];
+	}
+};
+
+/* Алгоритм SA-IS (Nong, Zhang, Chan) - построение суффиксного массива за O(size).
+ * Строка задаётся символами symbol(0), ..., symbol(size - 1) из диапазона [0, alphabet), 
+ * последний символ - единственный нулевой. Кроме suf, нужны size бит на типы суффиксов 
+ * и alphabet чисел на корзины; сокращённая задача решается рекурсивно в памяти самого suf. */
+template <class Symbols>
+void sa_is(const Symbols& symbol, int* suf, int size, int alphabet) {
+	if (size == 1) {
+		suf[0] = 0;
+		return;
+	}
+	// s_type[i] - меньше ли i-й суффикс, чем (i + 1)-й (S-суффикс); иначе это L-суффикс
+	vector <bool> s_type(size, false);
+	s_type[size - 1] = true;
+	for (int i = size - 2; i >= 0; i--)
+		s_type[i] = symbol(i) < symbol(i + 1) || (symbol(i) == symbol(i + 1) && s_type[i + 1]);
+	// LMS-суффикс - S-суффикс, перед которым стоит L-суффикс
+	auto is_lms = [&s_type](int i) { return i > 0 && s_type[i] && !s_type[i - 1]; };
+	
+	// Сортировка LMS-подстрок: расставляем LMS-суффиксы в концы корзин и индуцируем остальные.
+	vector <int> bucket;
+	get_buckets(symbol, size, alphabet, bucket, true);
+	fill(suf, suf + size, -1);
+	for (int i = 1; i < size; i++)
+		if (is_lms(i))
+			suf[--bucket[symbol(i)]] = i;
+	induce_l_suffixes(symbol, s_type, suf, size, alphabet, bucket);
+	induce_s_suffixes(symbol, s_type, suf, size, alphabet, bucket);
+	
+	// Отсортированные LMS-подстроки переносим в начало suf и нумеруем, равные получают одинаковые номера.
+	int lms_count = 0;
+	for (int i = 0; i < size; i++)
+		if (is_lms(suf[i]))
+			suf[lms_count++] = suf[i];
+	fill(suf + lms_count, suf + size, -1);
+	int names = 0, previous = -1;
+	for (int i = 0; i < lms_count; i++) {
+		int position = suf[i];
+		bool different = false;
+		for (int d = 0; d < size; d++) {
+			if (previous == -1 || symbol(position + d) != symbol(previous + d) || 
+			    s_type[position + d] != s_type[previous + d]) {
+				different = true;
+				break;
+			}
+			if (d > 0 && (is_lms(position + d) || is_lms(previous + d)))
+				break;
+		}
+		if (different) {
+			names++;
+			previous = position;
+		}
+		// LMS-позиции отстоят друг от друга хотя бы на 2, так что position / 2 не совпадают
+		suf[lms_count + position / 2] = names - 1;
+	}
+	for (int i = size - 1, j = size - 1; i >= lms_count; i--)
+		if (suf[i] >= 0)
+			suf[j--] = suf[i];
+	
+	// Сокращённая строка из номеров LMS-подстрок лежит в конце suf, её суффиксный массив строим в начале.
+	int* reduced = suf + size - lms_count;
+	if (names < lms_count) {
+		bucket = vector <int>();
+		sa_is(ReducedSymbols{reduced}, suf, lms_count, names);
+	}
+	else {
+		for (int i = 0; i < lms_count; i++)
+			suf[reduced[i]] = i;
+	}
+	
+	// Теперь LMS-суффиксы отсортированы: расставляем их по корзинам и индуцируем все остальные.
+	for (int i = 1, j = 0; i < size; i++)
+		if (is_lms(i))
+			reduced[j++] = i;
+	for (int i = 0; i < lms_count; i++)
+		suf[i] = reduced[suf[i]];
+	fill(suf + lms_count, suf + size, -1);
+	get_buckets(symbol, size, alphabet, bucket, true);
+	for (int i = lms_count - 1; i >= 0; i--) {
+		int j = suf[i];
+		suf[i] = -1;
+		suf[--bucket[symbol(j)]] = j;
+	}
+	induce_l_suffixes(symbol, s_type, suf, size, alphabet, bucket);
+	induce_s_suffixes(symbol, s_type, suf, size, alphabet, bucket);
+}
+
+// Символы строки для SA-IS: специальный символ в её конце получает номер 0.
+struct StringSymbols {
+	const string& s;
+	char sentinel;
+	int operator()(int i) const {
+		return s[i] - sentinel;
+	}
+};
+
+// Построение суффиксного массива suf (изначально заполнен нулями) по строке s алгоритмом SA-IS, за O(n).
+inline void build_suffix_array(const string& s, vector <int>& suf, Alphabet alphabet) {
+	sa_is(StringSymbols{s, alphabet.sentinel}, suf.data(), static_cast <int>(s.length()), alphabet.size);
+}
+
+// Построение массива lcp алгоритмом Касаи и др., за линейное время.
+// В данной реализации lcp[i] - длина наибольшего общего префикса suf[i] и suf[i - 1]-го суффиксов.
+// positions - обратный суффиксный массив: positions[suf[i]] = i; s - строка или массив чисел.
+template <class Text>
+void build_lcp (const Text& s, const vector <int>& suf, const vector <int>& positions, vector <int>& lcp) {
+	const int size = static_cast <int>(s.size());
+	int current_lcp = 0;
+	for (int i = 0; i < size; i++) {
+		if (current_lcp > 0)
+			current_lcp--;
+		if (positions[i] > 0) {
+			/* k - порядковый номер суффикса, стоящего перед i-м суффиксом в суффиксном массиве.
+			 * Здесь k-й суффикс - это s_k...s_{n-1}, i-й суффикс - s_i...s{n-1},
+			 * и один стоит прямо перед другим в суффиксном массиве. */
+			int k = suf[positions[i] - 1];
+			while (i + current_lcp < size && k + current_lcp < size && 
+				   s[i + current_lcp] == s[k + current_lcp])
+				current_lcp++;
+			lcp[positions[i]] = current_lcp;
+		}
+		else {
+			current_lcp = 0;
+			lcp[0] = -1;
+		}
+	}
+}
+
+// То же, обратный суффиксный массив считается на месте.
+template <class Text>
+void build_lcp (const Text& s, const vector <int>& suf, vector <int>& lcp) {
+	const int size = static_cast <int>(s.size());
+	vector <int> positions(size, 0);
+	for (int i = 0; i < size; i++)
+		positions[suf[i]] = i;
+	build_lcp(s, suf, positions, lcp);
+}
+
+/* Разбивает отрезок [0, size) на threads кусков и вызывает f(номер куска, начало, конец) 
+ * для каждого из них в отдельном потоке. При одинаковых threads и size разбиение всегда одно и то же. */
+template <class Function>
+void parallel_for(int threads, int size, Function f) {
+	int chunk = (size + threads - 1) / threads;
+	if (threads == 1) {
+		f(0, 0, size);
+		return;
+	}
+	vector <thread> workers;
+	for (int t = 0; t < threads; t++)
+		workers.emplace_back(f, t, min(size, t * chunk), min(size, (t + 1) * chunk));
+	for (auto& worker: workers)
+		worker.join();
+}
+
+/* Устойчивая сортировка values по ключам key(value) из [0, keys) поразрядно по 16 бит, начиная с младших.
+ * Каждый поток считает гистограмму своего куска, по ним вычисляются позиции, после чего потоки 
+ * независимо раскладывают свои элементы. buffer - вспомогательный массив того же размера. */
+template <class Key>
+void parallel_radix_sort(vector <int>& values, vector <int>& buffer, int keys, Key key, int threads) {
+	const int size = static_cast <int>(values.size());
+	const int digit_bits = 16;
+	for (int shift = 0; shift == 0 || (shift < 31 && (keys - 1) >> shift > 0); shift += digit_bits) {
+		const int radix = min(1 << digit_bits, ((keys - 1) >> shift) + 1);
+		const int mask = (1 << digit_bits) - 1;
+		vector <vector <int> > count(threads, vector <int>(radix, 0));
+		parallel_for(threads, size, [&](int t, int begin, int end) {
+			for (int i = begin; i < end; i++)
+				count[t][(key(values[i]) >> shift) & mask]++;
+		});
+		// элементы с меньшей цифрой идут раньше, при равной цифре - в порядке кусков
+		int sum = 0;
+		for (int digit = 0; digit < radix; digit++) {
+			for (int t = 0; t < threads; t++) {
+				int temp = count[t][digit];
+				count[t][digit] = sum;
+				sum += temp;
+			}
+		}
+		parallel_for(threads, size, [&](int t, int begin, int end) {
+			for (int i = begin; i < end; i++)
+				buffer[count[t][(key(values[i]) >> shift) & mask]++] = values[i];
+		});
+		values.swap(buffer);
+	}
+}
+
+/* Назначает классы эквивалентности суффиксам, отсортированным в suf по ключам key: 
+ * classes[suf[i]] - число различных ключей среди suf[0], ..., suf[i], минус один.
+ * Каждый поток сначала считает границы классов в своём куске, затем проставляет номера со своего смещения.
+ * Возвращает номер последнего класса. */
+template <class Key>
+int assign_classes(const vector <int>& suf, vector <int>& classes, Key key, int threads) {
+	const int size = static_cast <int>(suf.size());
+	vector <int> borders(threads, 0);
+	parallel_for(threads, size, [&](int t, int begin, int end) {
+		for (int i = max(begin, 1); i < end; i++)
+			if (key(suf[i]) != key(suf[i - 1]))
+				borders[t]++;
+	});
+	vector <int> first_class(threads, 0);
+	for (int t = 1; t < threads; t++)
+		first_class[t] = first_class[t - 1] + borders[t - 1];
+	parallel_for(threads, size, [&](int t, int begin, int end) {
+		int current_class = first_class[t];
+		for (int i = begin; i < end; i++) {
+			if (i > 0 && key(suf[i]) != key(suf[i - 1]))
+				current_class++;
+			classes[suf[i]] = current_class;
+		}
+	});
+	return first_class[threads - 1] + borders[threads - 1];
+}
+
+/* Построение суффиксного массива suf (изначально заполнен нулями) по строке s удвоением в threads потоков.
+ * Сортировки подсчётом заменены параллельной поразрядной сортировкой, классы назначаются параллельным 
+ * префиксным суммированием. Результат совпадает с build_suffix_array. */
+inline void build_suffix_array_parallel(const string& s, vector <int>& suf, Alphabet alphabet, int threads) {
+	const int size = static_cast <int>(s.length());
+	vector <int> classes(size, 0), new_classes(size, 0), buffer(size, 0);
+	iota(suf.begin(), suf.end(), 0);
+	auto symbol = [&s, alphabet](int position) { return s[position] - alphabet.sentinel; };
+	parallel_radix_sort(suf, buffer, alphabet.size, symbol, threads);
+	int current_class = assign_classes(suf, classes, symbol, threads);
+	
+	for (int current_length = 1; current_length < size && current_class < size - 1; current_length *= 2) {
+		// сортировка по 2 половине
+		parallel_for(threads, size, [&](int, int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				int position = suf[i] - current_length;
+				suf[i] = (position < 0 ? position + size : position);
+			}
+		});
+		// сортировка по 1 половине
+		parallel_radix_sort(suf, buffer, current_class + 1, [&classes](int position) { return classes[position]; }, threads);
+		// определение новых классов эквивалентности по паре классов половин
+		current_class = assign_classes(suf, new_classes, [&](int position) {
+			int second_half = position + current_length;
+			if (second_half >= size)
+				second_half -= size;
+			return (static_cast <uint64_t>(static_cast <uint32_t>(classes[position])) << 32) | 
+			       static_cast <uint32_t>(classes[second_half]);
+		}, threads);
+		classes.swap(new_classes);
+	}
+}
+
+/* Построение массива lcp в threads потоков через массив Φ (phi[suf[i]] = suf[i - 1]).
+ * По нему считается PLCP - lcp в порядке позиций строки, для которого работает то же рассуждение, 
+ * что и у Касаи. Каждый поток обрабатывает свой отрезок позиций, начиная с нулевого lcp.
+ * Результат совпадает с build_lcp. */
+inline void build_lcp_parallel(const string& s, const vector <int>& suf, vector <int>& lcp, int threads) {
+	const int size = static_cast <int>(s.length());
+	// phi[i] - суффикс, стоящий в суффиксном массиве перед i-м; затем на его месте - PLCP
+	vector <int> phi(size, 0);
+	parallel_for(threads, size, [&](int, int begin, int end) {
+		for (int i = begin; i < end; i++)
+			phi[suf[i]] = (i > 0 ? suf[i - 1] : -1);
+	});
+	parallel_for(threads, size, [&](int, int begin, int end) {
+		int current_lcp = 0;
+		for (int i = begin; i < end; i++) {
+			if (phi[i] < 0) {
+				current_lcp = 0;
+				continue;
+			}
+			int k = phi[i];
+			while (i + current_lcp < size && k + current_lcp < size && 
+			       s[i + current_lcp] == s[k + current_lcp])
+				current_lcp++;
+			phi[i] = current_lcp;
+			if (current_lcp > 0)
+				current_lcp--;
+		}
+	});
+	parallel_for(threads, size, [&](int, int begin, int end) {
+		for (int i = begin; i < end; i++)
+			lcp[i] = phi[suf[i]];
+	});
+}
+
+/* Суффиксный индекс строки: сама строка (со специальным символом в конце), суффиксный массив, lcp 
+ * и обратный суффиксный массив. Строится один раз через build, сохраняется в файл через save
+ * и затем открывается через load без повторного построения: файл отображается в память, 
+ * и таблицы читаются прямо из него. В файле числа можно хранить упакованными - 
+ * по ceil(log2(n + 1)) бит вместо 32. */
+class SuffixIndex {
+	// Массив чисел: обычный (plain) или упакованный по width бит (packed), значения хранятся со сдвигом bias.
+	struct ArrayView {
+		const int32_t* plain;
+		const uint64_t* packed;
+		int width, bias;
+		
+		int operator[](int i) const {
+			if (plain != nullptr)
+				return plain[i];
+			uint64_t bit = static_cast <uint64_t>(i) * width;
+			uint64_t word = bit >> 6, offset = bit & 63;
+			uint64_t value = packed[word] >> offset;
+			if (offset + width > 64)
+				value |= packed[word + 1] << (64 - offset);
+			return static_cast <int>(value & ((uint64_t(1) << width) - 1)) - bias;
+		}
+	};
+	
+	/* Формат файла: заголовок из header_size 64-битных чисел {file_magic, длина строки, width}, 
+	 * затем строка, дополненная нулями до кратной 8 длины, затем suf, lcp (+1) и обратный массив. 
+	 * При width == 32 каждый массив - это int32_t, дополненные до кратной 8 длины, 
+	 * иначе - упакованные по width бит 64-битные слова и ещё одно слово в конце. */
+	static const uint64_t file_magic = 0x3158444e49584653ULL;
+	static const int header_size = 3;
+	
+	// построенные в памяти данные
+	string owned_text;
+	vector <int> owned_suf, owned_lcp, owned_rank;
+	// то, через что идут запросы: указывают либо на данные выше, либо в отображённый файл
+	const char* text_data;
+	int text_size;
+	ArrayView suf_view, lcp_view, rank_view;
+	void* mapped;
+	size_t mapped_size;
+	
+	// Размер в байтах массива из count чисел по width бит в файле.
+	static size_t array_bytes(int count, int width) {
+		if (width == 32)
+			return (static_cast <size_t>(count) * 4 + 7) / 8 * 8;
+		return ((static_cast <size_t>(count) * width + 63) / 64 + 1) * 8;
+	}
+	
+	void release() {
+		if (mapped != nullptr)
+			munmap(mapped, mapped_size);
+		mapped = nullptr;
+	}
+	
+public:
+	SuffixIndex(): text_data(nullptr), text_size(0), suf_view(), lcp_view(), rank_view(), 
+	               mapped(nullptr), mapped_size(0) {}
+	
+	~SuffixIndex() {
+		release();
+	}
+	
+	/* Построение индекса по строке s из символов alphabet, которая оканчивается alphabet.sentinel. 
+	 * Если threads > 1, суффиксный массив и lcp строятся в threads потоках 
+	 * (не больше, чем по одному на parallel_min_chunk символов). */
+	void build(string s, Alphabet alphabet, int threads = 1) {
+		release();
+		owned_text = move(s);
+		const int size = static_cast <int>(owned_text.length());
+		owned_suf.assign(size, 0);
+		owned_lcp.assign(size, 0);
+		owned_rank.assign(size, 0);
+		threads = min(threads, size / parallel_min_chunk);
+		if (threads > 1) {
+			build_suffix_array_parallel(owned_text, owned_suf, alphabet, threads);
+			build_lcp_parallel(owned_text, owned_suf, owned_lcp, threads);
+		}
+		else {
+			build_suffix_array(owned_text, owned_suf, alphabet);
+		}
+		for (int i = 0; i < size; i++)
+			owned_rank[owned_suf[i]] = i;
+		if (threads <= 1)
+			build_lcp(owned_text, owned_suf, owned_rank, owned_lcp);
+		text_data = owned_text.data();
+		text_size = size;
+		suf_view = {owned_suf.data(), nullptr, 32, 0};
+		lcp_view = {owned_lcp.data(), nullptr, 32, 0};
+		rank_view = {owned_rank.data(), nullptr, 32, 0};
+	}
+	
+	/* Сохранение индекса в файл filename; если packed, числа упаковываются по ceil(log2(n + 1)) бит.
+	 * Возвращает false, если записать файл не удалось. */
+	bool save(const string& filename, bool packed) const {
+		int width = 32;
+		if (packed) {
+			width = 1;
+			while ((int64_t(1) << width) <= text_size)
+				width++;
+		}
+		ofstream fout(filename, ios::binary);
+		uint64_t header[header_size] = {file_magic, static_cast <uint64_t>(text_size), static_cast <uint64_t>(width)};
+		fout.write(reinterpret_cast <const char*>(header), sizeof(header));
+		fout.write(text_data, text_size);
+		fout.write(string((8 - text_size % 8) % 8, '\0').data(), (8 - text_size % 8) % 8);
+		auto write_array = [&](const ArrayView& array, int bias) {
+			if (width == 32) {
+				for (int i = 0; i < text_size; i++) {
+					int32_t value = array[i];
+					fout.write(reinterpret_cast <const char*>(&value), sizeof(value));
+				}
+				if (text_size % 2 != 0)
+					fout.write("\0\0\0\0", 4);
+				return;
+			}
+			vector <uint64_t> words(array_bytes(text_size, width) / 8, 0);
+			for (int i = 0; i < text_size; i++) {
+				uint64_t value = static_cast <uint64_t>(array[i] + bias);
+				uint64_t bit = static_cast <uint64_t>(i) * width;
+				words[bit >> 6] |= value << (bit & 63);
+				if ((bit & 63) + width > 64)
+					words[(bit >> 6) + 1] |= value >> (64 - (bit & 63));
+			}
+			fout.write(reinterpret_cast <const char*>(words.data()), words.size() * 8);
+		};
+		write_array(suf_view, 0);
+		write_array(lcp_view, 1);
+		write_array(rank_view, 0);
+		return static_cast <bool>(fout);
+	}
+	
+	/* Проверка массивов загружаемого индекса строки длины size: suf и rank - взаимно обратные перестановки, 
+	 * lcp[0] = -1, а lcp[i] не длиннее меньшего из суффиксов suf[i - 1] и suf[i]. 
+	 * Сами общие префиксы не сверяются со строкой: это стоило бы O(сумма lcp). */
+	static bool check_arrays(const ArrayView& suf, const ArrayView& lcp, const ArrayView& rank, int size) {
+		if (size == 0 || lcp[0] != -1)
+			return false;
+		for (int i = 0; i < size; i++) {
+			int position = suf[i];
+			if (position < 0 || position >= size || rank[position] != i)
+				return false;
+			if (i > 0 && (lcp[i] < 0 || lcp[i] > size - max(position, suf[i - 1])))
+				return false;
+		}
+		return true;
+	}
+	
+	/* Открытие индекса, сохранённого save, через mmap. 
+	 * Возвращает false, если файл не удалось открыть или он повреждён: 
+	 * не сходятся заголовок и размер файла или массивы не проходят check_arrays. */
+	bool load(const string& filename) {
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat file_stat;
+		if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast <off_t>(sizeof(uint64_t) * header_size)) {
+			close(fd);
+			return false;
+		}
+		size_t size = static_cast <size_t>(file_stat.st_size);
+		void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+			return false;
+		const uint64_t* header = static_cast <const uint64_t*>(data);
+		uint64_t length = header[1], width = header[2];
+		if (header[0] != file_magic || length > INT32_MAX || width < 1 || width > 32 || 
+		    sizeof(uint64_t) * header_size + (length + 7) / 8 * 8 + 3 * array_bytes(length, width) != size) {
+			munmap(data, size);
+			return false;
+		}
+		const char* position = static_cast <const char*>(data) + sizeof(uint64_t) * header_size;
+		const char* text = position;
+		position += (length + 7) / 8 * 8;
+		ArrayView views[3];
+		for (int k = 0; k < 3; k++) {
+			if (width == 32)
+				views[k] = {reinterpret_cast <const int32_t*>(position), nullptr, 32, 0};
+			else
+				views[k] = {nullptr, reinterpret_cast <const uint64_t*>(position), static_cast <int>(width), k == 1 ? 1 : 0};
+			position += array_bytes(static_cast <int>(length), static_cast <int>(width));
+		}
+		if (!check_arrays(views[0], views[1], views[2], static_cast <int>(length))) {
+			munmap(data, size);
+			return false;
+		}
+		release();
+		owned_text.clear();
+		owned_suf.clear();
+		owned_lcp.clear();
+		owned_rank.clear();
+		mapped = data;
+		mapped_size = size;
+		text_size = static_cast <int>(length);
+		text_data = text;
+		suf_view = views[0];
+		lcp_view = views[1];
+		rank_view = views[2];
+		return true;
+	}
+	
+	// длина строки вместе со специальным символом
+	int size() const {
+		return text_size;
+	}
+	
+	const char* text() const {
+		return text_data;
+	}
+	
+	// suf[i] - начало i-го по порядку суффикса
+	int suffix(int i) const {
+		return suf_view[i];
+	}
+	
+	// lcp[i] - длина наибольшего общего префикса suf[i] и suf[i - 1]-го суффиксов, lcp[0] = -1
+	int lcp(int i) const {
+		return lcp_view[i];
+	}
+	
+	// место суффикса, начинающегося в позиции position, в суффиксном массиве
+	int rank(int position) const {
+		return rank_view[position];
+	}
+	
+	string substring(int position, int length) const {
+		return string(text_data + position, length);
+	}
+	
+	SuffixIndex(const SuffixIndex&) = delete;
+	SuffixIndex& operator=(const SuffixIndex&) = delete;
+};
+
+/* Разреженная таблица: минимум на любом отрезке за O(1) после предподсчёта за O(n log n).
+ * table[k * size + i] - минимум на отрезке [i, i + 2^k). */
+class SparseTable {
+	int size;
+	vector <int> table;
+	
+public:
+	SparseTable(): size(0) {}
+	
+	// Построение по значениям value(0), ..., value(count - 1).
+	template <class Values>
+	void build(int count, Values value) {
+		size = count;
+		int levels = 1;
+		while ((1 << levels) <= size)
+			levels++;
+		table.assign(static_cast <size_t>(levels) * size, 0);
+		for (int i = 0; i < size; i++)
+			table[i] = value(i);
+		for (int k = 1; k < levels; k++) {
+			const int* previous = table.data() + static_cast <size_t>(k - 1) * size;
+			int* current = table.data() + static_cast <size_t>(k) * size;
+			for (int i = 0; i + (1 << k) <= size; i++)
+				current[i] = min(previous[i], previous[i + (1 << (k - 1))]);
+		}
+	}
+	
+	// минимум на отрезке [left, right]
+	int minimum(int left, int right) const {
+		int k = 31 - __builtin_clz(static_cast <unsigned>(right - left + 1));
+		return min(table[static_cast <size_t>(k) * size + left], table[static_cast <size_t>(k) * size + right - (1 << k) + 1]);
+	}
+	
+	size_t memory_usage() const {
+		return table.size() * sizeof(int);
+	}
+};
+
+/* Минимум на отрезке за O(1) с O(n) памяти: массив делится на блоки по block_size, 
+ * по минимумам блоков строится разреженная таблица, а внутри блока для каждой позиции r хранится маска 
+ * стека минимумов mask[r]: бит j установлен, если элемент j блока меньше всех после него до r. 
+ * Тогда минимум на [l, r] внутри блока - младший установленный бит маски mask[r] не младше l. */
+class BlockSparseTable {
+	static const int block_size = 32;
+	vector <int> values;
+	vector <uint32_t> mask;
+	SparseTable blocks;
+	
+	// минимум на отрезке [left, right] внутри одного блока
+	int in_block(int left, int right) const {
+		uint32_t stack = mask[right] & (~0u << (left % block_size));
+		return values[left - left % block_size + __builtin_ctz(stack)];
+	}
+	
+public:
+	template <class Values>
+	void build(int count, Values value) {
+		values.resize(count);
+		mask.assign(count, 0);
+		for (int i = 0; i < count; i++)
+			values[i] = value(i);
+		uint32_t stack = 0;
+		for (int i = 0; i < count; i++) {
+			int offset = i % block_size;
+			if (offset == 0)
+				stack = 0;
+			while (stack != 0 && values[i - offset + 31 - __builtin_clz(stack)] >= values[i])
+				stack ^= 1u << (31 - __builtin_clz(stack));
+			stack |= 1u << offset;
+			mask[i] = stack;
+		}
+		blocks.build((count + block_size - 1) / block_size, [&](int block) {
+			return in_block(block * block_size, min(count, (block + 1) * block_size) - 1);
+		});
+	}
+	
+	// минимум на отрезке [left, right]
+	int minimum(int left, int right) const {
+		int left_block = left / block_size, right_block = right / block_size;
+		if (left_block == right_block)
+			return in_block(left, right);
+		int result = min(in_block(left, left_block * block_size + block_size - 1), 
+		                 in_block(right_block * block_size, right));
+		if (left_block + 1 < right_block)
+			result = min(result, blocks.minimum(left_block + 1, right_block - 1));
+		return result;
+	}
+	
+	size_t memory_usage() const {
+		return values.size() * sizeof(int) + mask.size() * sizeof(uint32_t) + blocks.memory_usage();
+	}
+};
+
+/* Запросы к суффиксному индексу за O(1): lcp двух произвольных суффиксов (минимум lcp между их местами 
+ * в суффиксном массиве) и сравнение подстрок. RangeMinimum - SparseTable или BlockSparseTable. */
+template <class RangeMinimum>
+class LcpQueries {
+	const SuffixIndex& index;
+	RangeMinimum range_minimum;
+	
+public:
+	explicit LcpQueries(const SuffixIndex& index): index(index) {
+		range_minimum.build(index.size(), [&](int i) {
+			return index.lcp(i);
+		});
+	}
+	
+	// длина наибольшего общего префикса суффиксов, начинающихся в позициях first и second (без специального символа)
+	int lcp(int first, int second) const {
+		if (first == second)
+			return index.size() - 1 - first;
+		int first_rank = index.rank(first), second_rank = index.rank(second);
+		if (first_rank > second_rank)
+			swap(first_rank, second_rank);
+		return range_minimum.minimum(first_rank + 1, second_rank);
+	}
+	
+	/* Сравнение подстрок [first, first + first_length) и [second, second + second_length): 
+	 * -1, 0 или 1, если первая меньше, равна или больше второй в порядке суффиксного массива. */
+	int compare(int first, int first_length, int second, int second_length) const {
+		int common = min(lcp(first, second), min(first_length, second_length));
+		if (common == min(first_length, second_length))
+			return first_length < second_length ? -1 : (first_length > second_length ? 1 : 0);
+		return index.rank(first) < index.rank(second) ? -1 : 1;
+	}
+	
+	size_t memory_usage() const {
+		return range_minimum.memory_usage();
+	}
+};
+
+/* Временный файл для построения во внешней памяти: создаётся в каталоге directory и сразу удаляется 
+ * из него, так что место на диске освобождается вместе с объектом. Запись - только в конец, через буфер. */
+class TemporaryFile {
+	static const size_t buffer_size = 1 << 20;
+	int fd;
+	uint64_t written;
+	vector <char> buffer;
+	
+	// запись в конец файла в обход буфера
+	void write_through(const char* data, size_t bytes) {
+		size_t done = 0;
+		while (done < bytes) {
+			ssize_t result = pwrite(fd, data + done, bytes - done, written + done);
+			if (result <= 0)
+				throw runtime_error("cannot write a temporary file");
+			done += result;
+		}
+		written += bytes;
+	}
+	
+public:
+	explicit TemporaryFile(const string& directory): written(0) {
+		string name = directory + "/suffix-array-XXXXXX";
+		fd = mkstemp(&name[0]);
+		if (fd < 0)
+			throw runtime_error("cannot create a temporary file in " + directory);
+		unlink(name.c_str());
+		buffer.reserve(buffer_size);
+	}
+	
+	~TemporaryFile() {
+		close(fd);
+	}
+	
+	void write(const void* data, size_t bytes) {
+		const char* begin = static_cast <const char*>(data);
+		if (buffer.size() + bytes > buffer_size)
+			flush();
+		if (bytes > buffer_size)
+			write_through(begin, bytes);
+		else
+			buffer.insert(buffer.end(), begin, begin + bytes);
+	}
+	
+	// Записывает буфер на диск; нужно перед чтением.
+	void flush() {
+		write_through(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+	
+	// размер в байтах вместе с ещё не записанным буфером
+	uint64_t size() const {
+		return written + buffer.size();
+	}
+	
+	int descriptor() const {
+		return fd;
+	}
+	
+	TemporaryFile(const TemporaryFile&) = delete;
+	TemporaryFile& operator=(const TemporaryFile&) = delete;
+};
+
+// Последовательное чтение записей типа Record с номерами [begin, end) из временного файла.
+template <class Record>
+class RecordReader {
+	int fd;
+	uint64_t next_record, end;
+	vector <Record> buffer;
+	size_t position;
+	
+public:
+	RecordReader(TemporaryFile& file, uint64_t begin, uint64_t end, size_t buffer_records = 1 << 16): 
+	             fd(file.descriptor()), next_record(begin), end(end), position(0) {
+		file.flush();
+		buffer.reserve(max <size_t>(buffer_records, 1));
+	}
+	
+	RecordReader(TemporaryFile& file, uint64_t begin = 0): RecordReader(file, begin, file.size() / sizeof(Record)) {}
+	
+	bool next(Record& record) {
+		if (position == buffer.size()) {
+			if (next_record == end)
+				return false;
+			size_t count = static_cast <size_t>(min <uint64_t>(buffer.capacity(), end - next_record));
+			buffer.resize(count);
+			size_t done = 0, bytes = count * sizeof(Record);
+			char* data = reinterpret_cast <char*>(buffer.data());
+			while (done < bytes) {
+				ssize_t result = pread(fd, data + done, bytes - done, next_record * sizeof(Record) + done);
+				if (result <= 0)
+					throw runtime_error("cannot read a temporary file");
+				done += result;
+			}
+			next_record += count;
+			position = 0;
+		}
+		record = buffer[position++];
+		return true;
+	}
+};
+
+/* Сортировка во внешней памяти: записи копятся в буфере на memory_limit байт, каждый заполненный буфер 
+ * сортируется и дописывается во временный файл как отдельная серия, а после finish серии сливаются 
+ * через кучу. Если все записи поместились в буфер, диск не используется. */
+template <class Record>
+class ExternalSorter {
+	struct HeapItem {
+		Record record;
+		int run;
+		// priority_queue достаёт наибольший элемент, а нужен наименьший
+		bool operator<(const HeapItem& other) const {
+			return other.record < record;
+		}
+	};
+	
+	size_t memory_limit;
+	string directory;
+	vector <Record> buffer;
+	size_t position;
+	unique_ptr <TemporaryFile> file;
+	vector <uint64_t> run_ends;
+	vector <RecordReader <Record>> readers;
+	priority_queue <HeapItem> heap;
+	
+	void write_run() {
+		sort(buffer.begin(), buffer.end());
+		if (!file)
+			file.reset(new TemporaryFile(directory));
+		file->write(buffer.data(), buffer.size() * sizeof(Record));
+		run_ends.push_back(file->size() / sizeof(Record));
+		buffer.clear();
+	}
+	
+public:
+	ExternalSorter(size_t memory_limit, const string& directory): 
+	               memory_limit(max <size_t>(memory_limit / sizeof(Record), 1)), directory(directory), position(0) {
+		buffer.reserve(this->memory_limit);
+	}
+	
+	void push(const Record& record) {
+		buffer.push_back(record);
+		if (buffer.size() == memory_limit)
+			write_run();
+	}
+	
+	void finish() {
+		if (run_ends.empty()) {
+			sort(buffer.begin(), buffer.end());
+			return;
+		}
+		if (!buffer.empty())
+			write_run();
+		vector <Record>().swap(buffer);
+		size_t buffer_records = memory_limit / run_ends.size();
+		for (size_t run = 0; run < run_ends.size(); run++) {
+			readers.emplace_back(*file, run == 0 ? 0 : run_ends[run - 1], run_ends[run], buffer_records);
+			Record record;
+			if (readers.back().next(record))
+				heap.push({record, static_cast <int>(run)});
+		}
+	}
+	
+	// Следующая по порядку запись; false, если записи кончились.
+	bool next(Record& record) {
+		if (readers.empty()) {
+			if (position == buffer.size())
+				return false;
+			record = buffer[position++];
+			return true;
+		}
+		if (heap.empty())
+			return false;
+		HeapItem top = heap.top();
+		heap.pop();
+		record = top.record;
+		if (readers[top.run].next(top.record))
+			heap.push(top);
+		return true;
+	}
+};
+
+/* Запись для сортировок во внешней памяти: три числа из [-1, external_position_limit) по 40 бит 
+ * в двух 64-битных словах, 16 байт вместо 24. Числа хранятся увеличенными на 1: в high - key и старшие 
+ * 24 бита second, в low - младшие 16 бит second и value, так что порядок по (key, second) - 
+ * это порядок по (high, low >> 40). */
+const int64_t external_position_limit = (int64_t(1) << 40) - 1;
+
+struct ExternalRecord {
+	uint64_t high, low;
+	
+	ExternalRecord() {}
+	
+	ExternalRecord(int64_t key, int64_t second, int64_t value) {
+		uint64_t biased_second = static_cast <uint64_t>(second + 1);
+		high = (static_cast <uint64_t>(key + 1) << 24) | (biased_second >> 16);
+		low = (biased_second << 48) | static_cast <uint64_t>(value + 1);
+	}
+	
+	int64_t key() const {
+		return static_cast <int64_t>(high >> 24) - 1;
+	}
+	
+	int64_t second() const {
+		return static_cast <int64_t>(((high & 0xffffff) << 16) | (low >> 48)) - 1;
+	}
+	
+	int64_t value() const {
+		return static_cast <int64_t>(low & ((uint64_t(1) << 40) - 1)) - 1;
+	}
+	
+	bool operator<(const ExternalRecord& other) const {
+		return high < other.high || (high == other.high && (low >> 40) < (other.low >> 40));
+	}
+};
+
+/* Строка во внешней памяти: файлы, отображённые в память, за каждым из которых следует свой 
+ * символ-разделитель. Переводы строк в конце файла отбрасываются. Позиции 64-битные. */
+class ExternalText {
+	struct Part {
+		const char* data;
+		int64_t size;
+		char separator;
+		void* mapped;
+		size_t mapped_size;
+	};
+	vector <Part> parts;
+	int64_t total;
+	
+public:
+	ExternalText(): total(0) {}
+	
+	~ExternalText() {
+		for (const Part& part : parts)
+			if (part.mapped != nullptr)
+				munmap(part.mapped, part.mapped_size);
+	}
+	
+	// Добавляет содержимое файла filename и разделитель separator; false, если файл не открылся.
+	bool add(const string& filename, char separator) {
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat file_stat;
+		if (fstat(fd, &file_stat) != 0) {
+			close(fd);
+			return false;
+		}
+		Part part = {nullptr, 0, separator, nullptr, static_cast <size_t>(file_stat.st_size)};
+		if (part.mapped_size > 0) {
+			part.mapped = mmap(nullptr, part.mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (part.mapped == MAP_FAILED) {
+				close(fd);
+				return false;
+			}
+			madvise(part.mapped, part.mapped_size, MADV_SEQUENTIAL);
+			part.data = static_cast <const char*>(part.mapped);
+			part.size = static_cast <int64_t>(part.mapped_size);
+			while (part.size > 0 && (part.data[part.size - 1] == '\n' || part.data[part.size - 1] == '\r'))
+				part.size--;
+		}
+		close(fd);
+		parts.push_back(part);
+		total += part.size + 1;
+		return true;
+	}
+	
+	// длина вместе с разделителями
+	int64_t size() const {
+		return total;
+	}
+	
+	// длина первого файла (без разделителя)
+	int64_t first_size() const {
+		return parts.empty() ? 0 : parts[0].size;
+	}
+	
+	char operator[](int64_t i) const {
+		for (const Part& part : parts) {
+			if (i < part.size)
+				return part.data[i];
+			if (i == part.size)
+				return part.separator;
+			i -= part.size + 1;
+		}
+		return 0;
+	}
+	
+	// Копирует символы [begin, begin + count) в out; так окна строки читаются подряд, по частям целиком.
+	void read(int64_t begin, int64_t count, char* out) const {
+		for (const Part& part : parts) {
+			if (count == 0)
+				return;
+			if (begin < part.size) {
+				int64_t taken = min(count, part.size - begin);
+				memcpy(out, part.data + begin, static_cast <size_t>(taken));
+				out += taken;
+				begin += taken;
+				count -= taken;
+			}
+			if (count > 0 && begin == part.size) {
+				*out++ = part.separator;
+				begin++;
+				count--;
+			}
+			begin -= part.size + 1;
+		}
+	}
+	
+	ExternalText(const ExternalText&) = delete;
+	ExternalText& operator=(const ExternalText&) = delete;
+};
+
+/* Построение суффиксного массива удвоением во внешней памяти (Dementiev и др.). 
+ * Классы names суффиксов лежат в файле по порядку позиций. На каждом шаге пары (names[i], names[i + h]) 
+ * двумя последовательными проходами по этому файлу подаются во внешнюю сортировку, по отсортированным парам 
+ * назначаются новые классы (номер первой пары группы), и они сортируются обратно по позициям. 
+ * Когда все классы различны, порядок пар - суффиксный массив. Сортировки получают по memory_limit / 2 байт 
+ * (одновременно работают две). Файл классов удаляется, как только пары поданы в сортировку, так что на диске 
+ * одновременно лежат две сортировки по 16 байт и порядок пар по 8 байт - около 40 байт на символ. 
+ * Позиции должны быть меньше external_position_limit (около 10^12), иначе бросается runtime_error. 
+ * Возвращает файл из n 64-битных позиций. */
+inline unique_ptr <TemporaryFile> build_suffix_array_external(const ExternalText& text, Alphabet alphabet, size_t memory_limit, 
+                                                              const string& directory) {
+	const int64_t size = text.size();
+	if (size >= external_position_limit)
+		throw runtime_error("the text is too long for 40-bit positions");
+	unique_ptr <TemporaryFile> names(new TemporaryFile(directory));
+	for (int64_t i = 0; i < size; i++) {
+		int64_t name = text[i] - alphabet.sentinel;
+		names->write(&name, sizeof(name));
+	}
+	for (int64_t h = 1; ; h *= 2) {
+		ExternalSorter <ExternalRecord> pairs(memory_limit / 2, directory);
+		{
+			RecordReader <int64_t> current(*names), shifted(*names, min(h, size));
+			for (int64_t i = 0; i < size; i++) {
+				int64_t first = 0, second = -1;
+				current.next(first);
+				if (i + h < size)
+					shifted.next(second);
+				pairs.push({first, second, i});
+			}
+		}
+		names.reset();
+		pairs.finish();
+		
+		unique_ptr <TemporaryFile> order(new TemporaryFile(directory));
+		ExternalSorter <ExternalRecord> by_position(memory_limit / 2, directory);
+		ExternalRecord record, previous = {0, 0, 0};
+		int64_t index = 0, name = 0, groups = 0;
+		while (pairs.next(record)) {
+			if (index == 0 || previous < record) {
+				name = index;
+				groups++;
+			}
+			int64_t position = record.value();
+			by_position.push({position, 0, name});
+			order->write(&position, sizeof(position));
+			previous = record;
+			index++;
+		}
+		if (groups == size || h >= size) {
+			order->flush();
+			return order;
+		}
+		
+		order.reset();
+		by_position.finish();
+		names.reset(new TemporaryFile(directory));
+		while (by_position.next(record)) {
+			name = record.value();
+			names->write(&name, sizeof(name));
+		}
+	}
+}
+
+/* Сравнение пар суффиксов во внешней памяти: pairs выдаёт записи (i, j, i) по возрастанию i, 
+ * для каждой пары в results пишется (i, 0, lcp суффиксов i и j). Строка читается только окнами подряд.
+ * Запись (a, b, i) - пара, у которой уже совпали text[i, a) и text[j, b). За раунд пары идут по возрастанию a, 
+ * окно X - выровненный на window_size отрезок строки, содержащий a. Пары из X берутся кусками 
+ * на chunk_memory байт и сортируются по b, окно Y загружается с b первой ещё не разобранной пары. 
+ * Пара сравнивается, пока a и b внутри своих окон: при несовпадении ответ готов, при выходе b за Y пара 
+ * ждёт следующего окна Y, а при выходе a за X переходит в следующий раунд - с начала следующего окна X, 
+ * поэтому за каждый раунд она продвигается на window_size. Раундов не больше max lcp / window_size + 1. 
+ * Окна Y одного прохода по куску не пересекаются, так что раунд читает строку не больше одного раза 
+ * на каждый проход по куску: чем больше кусок, тем меньше чтений. */
+inline void compare_pairs_external(const ExternalText& text, unique_ptr <ExternalSorter <ExternalRecord>> pairs, 
+                                   ExternalSorter <ExternalRecord>& results, int64_t window_size, size_t chunk_memory, 
+                                   size_t sorter_memory, const string& directory) {
+	struct Pair {
+		int64_t a, b, i;
+	};
+	const int64_t size = text.size();
+	const size_t chunk_records = max <size_t>(chunk_memory / sizeof(Pair), 1);
+	vector <char> x_window(static_cast <size_t>(window_size)), y_window(static_cast <size_t>(window_size));
+	vector <Pair> chunk;
+	chunk.reserve(chunk_records);
+	while (pairs) {
+		unique_ptr <ExternalSorter <ExternalRecord>> next(new ExternalSorter <ExternalRecord>(sorter_memory, directory));
+		bool carried = false;
+		ExternalRecord record;
+		bool has_record = pairs->next(record);
+		while (has_record) {
+			const int64_t x_begin = record.key() / window_size * window_size;
+			const int64_t x_end = min(x_begin + window_size, size);
+			text.read(x_begin, x_end - x_begin, x_window.data());
+			while (has_record && record.key() < x_end) {
+				chunk.clear();
+				while (has_record && record.key() < x_end && chunk.size() < chunk_records) {
+					chunk.push_back({record.key(), record.second(), record.value()});
+					has_record = pairs->next(record);
+				}
+				while (!chunk.empty()) {
+					sort(chunk.begin(), chunk.end(), [](const Pair& left, const Pair& right) { return left.b < right.b; });
+					int64_t y_begin = 0, y_end = 0;
+					size_t waiting = 0;
+					for (size_t k = 0; k < chunk.size(); k++) {
+						Pair pair = chunk[k];
+						if (pair.b >= y_end) {
+							y_begin = pair.b;
+							y_end = min(y_begin + window_size, size);
+							text.read(y_begin, y_end - y_begin, y_window.data());
+						}
+						while (pair.a < x_end && pair.b < y_end && x_window[pair.a - x_begin] == y_window[pair.b - y_begin]) {
+							pair.a++;
+							pair.b++;
+						}
+						if ((pair.a < x_end && pair.b < y_end) || pair.a == size || pair.b == size) {
+							results.push({pair.i, 0, pair.a - pair.i});
+						}
+						else if (pair.a == x_end) {
+							next->push({pair.a, pair.b, pair.i});
+							carried = true;
+						}
+						else {
+							chunk[waiting++] = pair;
+						}
+					}
+					chunk.resize(waiting);
+				}
+			}
+		}
+		pairs.reset();
+		if (carried) {
+			next->finish();
+			pairs = move(next);
+		}
+	}
+}
+
+/* Построение lcp во внешней памяти без произвольного доступа к строке (Kärkkäinen, Kempa). 
+ * Пусть Φ[i] - суффикс, стоящий в суффиксном массиве перед суффиксом i, и PLCP[i] - их lcp. 
+ * Если text[i - 1] == text[Φ[i] - 1], то PLCP[i] = PLCP[i - 1] - 1 (как в алгоритме Касаи), 
+ * а сумма остальных, несводимых PLCP - O(n log n) (Kärkkäinen, Manzini, Puglisi). Поэтому:
+ * 1. Суффиксный массив сортируется по позициям, и за один проход по строке для каждого суффикса 
+ *    берётся предшествующий ему символ; символы сортируются обратно в порядок суффиксного массива, 
+ *    и несводимые пары - те, у которых он отличается от символа предыдущего суффикса (или его нет).
+ * 2. Несводимые пары сравниваются окнами строки (compare_pairs_external).
+ * 3. Проход по позициям достраивает сводимые PLCP, и они сортируются в порядок суффиксного массива.
+ * Строка читается только подряд, так что она может не помещаться в память. Сортировкам достаётся 
+ * memory_limit / 2 байт на шагах 1 и 3 и по memory_limit / 8 на шаге 2, где ещё по memory_limit / 16 байт 
+ * занимают два окна строки и memory_limit / 2 - кусок пар. Кроме суффиксного массива, на диске нужно 
+ * не больше 56 байт на символ (обратный массив и три сортировки по 16 байт на шаге 2, если почти все пары 
+ * несводимы и длинные). Возвращает файл из n 64-битных lcp, lcp[0] = -1. */
+inline unique_ptr <TemporaryFile> build_lcp_external(const ExternalText& text, TemporaryFile& suf, size_t memory_limit, 
+                                                     const string& directory) {
+	unique_ptr <TemporaryFile> rank(new TemporaryFile(directory));
+	unique_ptr <ExternalSorter <ExternalRecord>> symbols(new ExternalSorter <ExternalRecord>(memory_limit / 2, directory));
+	{
+		ExternalSorter <ExternalRecord> by_position(memory_limit / 2, directory);
+		RecordReader <int64_t> reader(suf);
+		int64_t position = 0;
+		for (int64_t i = 0; reader.next(position); i++)
+			by_position.push({position, 0, i});
+		by_position.finish();
+		ExternalRecord record;
+		while (by_position.next(record)) {
+			int64_t i = record.value();
+			rank->write(&i, sizeof(i));
+			symbols->push({i, 0, record.key() > 0 ? static_cast <unsigned char>(text[record.key() - 1]) : -1});
+		}
+	}
+	symbols->finish();
+	
+	unique_ptr <ExternalSorter <ExternalRecord>> pairs(new ExternalSorter <ExternalRecord>(memory_limit / 8, directory));
+	{
+		RecordReader <int64_t> reader(suf);
+		ExternalRecord record;
+		int64_t position = 0, previous = -1, previous_symbol = -1;
+		while (reader.next(position) && symbols->next(record)) {
+			int64_t symbol = record.value();
+			if (previous >= 0 && (symbol < 0 || symbol != previous_symbol))
+				pairs->push({position, previous, position});
+			previous = position;
+			previous_symbol = symbol;
+		}
+	}
+	symbols.reset();
+	pairs->finish();
+	
+	ExternalSorter <ExternalRecord> irreducible(memory_limit / 8, directory);
+	compare_pairs_external(text, move(pairs), irreducible, max <int64_t>(memory_limit / 16, 1), memory_limit / 2, 
+	                       memory_limit / 8, directory);
+	irreducible.finish();
+	
+	ExternalSorter <ExternalRecord> by_rank(memory_limit / 2, directory);
+	{
+		RecordReader <int64_t> reader(*rank);
+		ExternalRecord record;
+		bool has_record = irreducible.next(record);
+		int64_t i = 0, current_lcp = 0;
+		for (int64_t position = 0; reader.next(i); position++) {
+			if (has_record && record.key() == position) {
+				current_lcp = record.value();
+				has_record = irreducible.next(record);
+			}
+			else if (i > 0) {
+				current_lcp--;
+			}
+			by_rank.push({i, 0, i == 0 ? -1 : current_lcp});
+		}
+	}
+	rank.reset();
+	by_rank.finish();
+	
+	unique_ptr <TemporaryFile> lcp(new TemporaryFile(directory));
+	ExternalRecord record;
+	while (by_rank.next(record)) {
+		int64_t value = record.value();
+		lcp->write(&value, sizeof(value));
+	}
+	lcp->flush();
+	return lcp;
+}
+
+#endif